@@ -0,0 +1,385 @@
+#include "sobel_async_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#ifdef SOBEL_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+// Largest single read/write request; io_uring lengths are 32-bit.
+#define MAX_IO_CHUNK (1u << 30)
+
+void releaseFileData(FileData* file) {
+    free(file->data);
+    file->data = NULL;
+    file->size = 0;
+}
+
+// Opens the file and allocates a buffer for all of it.
+static int openForRead(FileData* file, int* fd_out) {
+    int fd = open(file->path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", file->path.c_str());
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    file->size = (size_t)st.st_size;
+    file->data = (uint8_t*) malloc(file->size ? file->size : 1);
+    if (!file->data) {
+        close(fd);
+        return -1;
+    }
+    *fd_out = fd;
+    return 0;
+}
+
+static int readWholeFile(FileData* file) {
+    int fd;
+    if (openForRead(file, &fd) != 0) {
+        return -1;
+    }
+    size_t done = 0;
+    while (done < file->size) {
+        size_t chunk = file->size - done;
+        ssize_t got = read(fd, file->data + done, chunk < MAX_IO_CHUNK ? chunk : MAX_IO_CHUNK);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            close(fd);
+            return -1;
+        }
+        done += got;
+    }
+    close(fd);
+    return 0;
+}
+
+static int writeWholeFile(const std::string& path, const uint8_t* data, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", path.c_str());
+        return -1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        size_t chunk = size - done;
+        ssize_t put = write(fd, data + done, chunk < MAX_IO_CHUNK ? chunk : MAX_IO_CHUNK);
+        if (put < 0 && errno == EINTR) {
+            continue;
+        }
+        if (put <= 0) {
+            close(fd);
+            return -1;
+        }
+        done += put;
+    }
+    return close(fd);
+}
+
+#ifdef SOBEL_HAVE_LIBURING
+// user_data of cancel requests, which no file index can take.
+#define CANCEL_TAG UINTPTR_MAX
+
+// Waits for the next completion, retrying when a signal interrupts the wait.
+static int waitCompletion(struct io_uring* ring, struct io_uring_cqe** cqe) {
+    int result;
+    do {
+        result = io_uring_wait_cqe(ring, cqe);
+    } while (result == -EINTR);
+    return result;
+}
+
+// Submits `count` prepared requests, retrying after a signal or a partial
+// submit. Returns -1 if the ring refused them.
+static int submitAll(struct io_uring* ring, unsigned count) {
+    while (count > 0) {
+        int submitted = io_uring_submit(ring);
+        if (submitted == -EINTR) {
+            continue;
+        }
+        if (submitted <= 0) {
+            return -1;
+        }
+        count -= (unsigned)submitted < count ? (unsigned)submitted : count;
+    }
+    return 0;
+}
+
+// Called when the ring fails with reads still in flight. Asks the kernel to
+// cancel them and reaps what completes. A read that is still unaccounted for
+// may yet write into its buffer, so that buffer is deliberately leaked rather
+// than handed to the consumer, who would free it.
+static void abandonReads(struct io_uring* ring, std::vector<FileData>& files,
+                         std::vector<char>& in_flight, size_t outstanding) {
+    unsigned cancels = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct io_uring_sqe* sqe = in_flight[i] ? io_uring_get_sqe(ring) : NULL;
+        if (sqe) {
+            io_uring_prep_cancel(sqe, (void*)(uintptr_t)i, 0);
+            io_uring_sqe_set_data(sqe, (void*)(uintptr_t)CANCEL_TAG);
+            cancels++;
+        }
+    }
+    if (submitAll(ring, cancels) == 0) {
+        while (outstanding > 0) {
+            struct io_uring_cqe* cqe;
+            if (waitCompletion(ring, &cqe) != 0) {
+                break;
+            }
+            uintptr_t tag = (uintptr_t)io_uring_cqe_get_data(cqe);
+            io_uring_cqe_seen(ring, cqe);
+            if (tag != CANCEL_TAG && in_flight[tag]) {
+                in_flight[tag] = 0;
+                outstanding--;
+            }
+        }
+    }
+    for (size_t i = 0; i < files.size(); i++) {
+        if (in_flight[i]) {
+            files[i].data = NULL;
+            files[i].size = 0;
+            files[i].status = -1;
+        }
+    }
+}
+
+// Submits one read per file and reaps completions until every file is
+// complete, resubmitting the tail of any short read. Files that were not
+// read in full get status -1. Returns -1 if the ring itself failed, after
+// which it must not be used again.
+static int readBatchUring(struct io_uring* ring, std::vector<FileData>& files) {
+    std::vector<int> fds(files.size(), -1);
+    std::vector<size_t> offsets(files.size(), 0);
+    std::vector<char> in_flight(files.size(), 0);
+    size_t outstanding = 0;
+    int ring_status = 0;
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (openForRead(&files[i], &fds[i]) != 0) {
+            files[i].status = -1;
+            continue;
+        }
+        if (files[i].size == 0) {
+            continue;
+        }
+        struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+        size_t length = files[i].size < MAX_IO_CHUNK ? files[i].size : MAX_IO_CHUNK;
+        io_uring_prep_read(sqe, fds[i], files[i].data, (unsigned)length, 0);
+        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)i);
+        in_flight[i] = 1;
+        outstanding++;
+    }
+    if (submitAll(ring, (unsigned)outstanding) != 0) {
+        abandonReads(ring, files, in_flight, outstanding);
+        outstanding = 0;
+        ring_status = -1;
+    }
+
+    while (outstanding > 0) {
+        struct io_uring_cqe* cqe;
+        if (waitCompletion(ring, &cqe) != 0) {
+            abandonReads(ring, files, in_flight, outstanding);
+            ring_status = -1;
+            break;
+        }
+        size_t i = (size_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+        int result = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+
+        if (result > 0) {
+            offsets[i] += (size_t)result;
+        }
+        if (result <= 0 || offsets[i] == files[i].size) {
+            in_flight[i] = 0;
+            outstanding--;
+            continue;
+        }
+        struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+        size_t remaining = files[i].size - offsets[i];
+        io_uring_prep_read(sqe, fds[i], files[i].data + offsets[i],
+                           (unsigned)(remaining < MAX_IO_CHUNK ? remaining : MAX_IO_CHUNK), offsets[i]);
+        io_uring_sqe_set_data(sqe, (void*)(uintptr_t)i);
+        if (submitAll(ring, 1) != 0) {
+            abandonReads(ring, files, in_flight, outstanding);
+            ring_status = -1;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i].status == 0 && offsets[i] < files[i].size) {
+            files[i].status = -1;
+        }
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    return ring_status;
+}
+#endif
+
+FilePrefetcher::FilePrefetcher(const std::vector<std::string>& paths, int depth)
+    : paths_(paths),
+      depth_(depth > 0 ? (size_t)depth : 1),
+      handed_out_(0),
+      stop_(false),
+      thread_(&FilePrefetcher::run, this) {
+}
+
+FilePrefetcher::~FilePrefetcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        changed_.notify_all();
+    }
+    thread_.join();
+    for (size_t i = 0; i < ready_.size(); i++) {
+        releaseFileData(&ready_[i]);
+    }
+}
+
+void FilePrefetcher::run() {
+#ifdef SOBEL_HAVE_LIBURING
+    struct io_uring ring;
+    bool use_uring = io_uring_queue_init((unsigned)depth_, &ring, 0) == 0;
+    // Without io_uring hand each file over as soon as it is read.
+    size_t max_batch = use_uring ? depth_ : 1;
+#else
+    size_t max_batch = 1;
+#endif
+    size_t next_index = 0;
+    while (next_index < paths_.size()) {
+        size_t batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, [this] { return stop_ || ready_.size() < depth_; });
+            if (stop_) {
+                break;
+            }
+            batch = std::min(std::min(depth_ - ready_.size(), max_batch), paths_.size() - next_index);
+        }
+
+        std::vector<FileData> files(batch);
+        for (size_t i = 0; i < batch; i++) {
+            files[i].path = paths_[next_index + i];
+            files[i].data = NULL;
+            files[i].size = 0;
+            files[i].status = 0;
+        }
+#ifdef SOBEL_HAVE_LIBURING
+        if (use_uring) {
+            if (readBatchUring(&ring, files) != 0) {
+                fprintf(stderr, "Warning: io_uring failed, reading the remaining files with read().\n");
+                io_uring_queue_exit(&ring);
+                use_uring = false;
+                max_batch = 1;
+            }
+        } else
+#endif
+        {
+            for (size_t i = 0; i < batch; i++) {
+                files[i].status = readWholeFile(&files[i]);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < batch; i++) {
+            ready_.push_back(files[i]);
+        }
+        next_index += batch;
+        changed_.notify_all();
+    }
+#ifdef SOBEL_HAVE_LIBURING
+    if (use_uring) {
+        io_uring_queue_exit(&ring);
+    }
+#endif
+}
+
+bool FilePrefetcher::next(FileData* file) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return !ready_.empty() || handed_out_ == paths_.size(); });
+    if (ready_.empty()) {
+        return false;
+    }
+    *file = ready_.front();
+    ready_.pop_front();
+    handed_out_++;
+    changed_.notify_all();
+    return true;
+}
+
+AsyncWriter::AsyncWriter(int depth)
+    : depth_(depth > 0 ? (size_t)depth : 1),
+      in_flight_(0),
+      failures_(0),
+      stop_(false),
+      thread_(&AsyncWriter::run, this) {
+}
+
+AsyncWriter::~AsyncWriter() {
+    drain();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        changed_.notify_all();
+    }
+    thread_.join();
+}
+
+void AsyncWriter::submit(const std::string& path, uint8_t* data, size_t size) {
+    FileData file;
+    file.path = path;
+    file.data = data;
+    file.size = size;
+    file.status = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return pending_.size() + in_flight_ < depth_; });
+    pending_.push_back(file);
+    changed_.notify_all();
+}
+
+int AsyncWriter::drain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return pending_.empty() && in_flight_ == 0; });
+    int failures = failures_;
+    failures_ = 0;
+    return failures;
+}
+
+void AsyncWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+        FileData file = pending_.front();
+        pending_.pop_front();
+        in_flight_++;
+
+        lock.unlock();
+        int status = writeWholeFile(file.path, file.data, file.size);
+        releaseFileData(&file);
+        lock.lock();
+
+        if (status != 0) {
+            failures_++;
+        }
+        in_flight_--;
+        changed_.notify_all();
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef SOBEL_ASYNC_IO_H
+#define SOBEL_ASYNC_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whole compressed file held in memory, ready for jpeg_mem_src.
+typedef struct {
+    std::string path;
+    uint8_t* data;
+    size_t size;
+    int status;  // 0 on success, -1 if the file could not be read
+} FileData;
+
+void releaseFileData(FileData* file);
+
+// Reads a list of files ahead of the consumer on a background thread, keeping
+// at most `depth` of them in memory. Built with -DSOBEL_HAVE_LIBURING (and
+// -luring) each batch is submitted to io_uring so the reads are in flight
+// together; otherwise the thread reads them one after another with read().
+// The io_uring path is opt-in and has only been run against a mock ring. If
+// the ring fails, reads still in flight are cancelled, their files are handed
+// out with status -1, and the remaining files are read with read().
+// Files are handed out in the order they were given.
+class FilePrefetcher {
+public:
+    FilePrefetcher(const std::vector<std::string>& paths, int depth);
+    ~FilePrefetcher();
+
+    // Blocks until the next file is in memory. Returns false when all files
+    // have been handed out. The caller releases file->data.
+    bool next(FileData* file);
+
+private:
+    void run();
+
+    std::vector<std::string> paths_;
+    size_t depth_;
+    size_t handed_out_;
+    bool stop_;
+    std::deque<FileData> ready_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+// Writes finished buffers to disk on a background thread so encode of the
+// next image overlaps the write of the previous one. Takes ownership of
+// malloc'd buffers such as those from jpeg_mem_dest. At most `depth`
+// buffers are held at once, counting the one being written.
+class AsyncWriter {
+public:
+    explicit AsyncWriter(int depth);
+    ~AsyncWriter();
+
+    // Blocks while `depth` writes are outstanding, so a disk slower than
+    // compute holds the producer back instead of piling up outputs.
+    void submit(const std::string& path, uint8_t* data, size_t size);
+
+    // Waits for every submitted write. Returns the number that failed.
+    int drain();
+
+private:
+    void run();
+
+    size_t depth_;
+    std::deque<FileData> pending_;
+    size_t in_flight_;
+    int failures_;
+    bool stop_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::thread thread_;
+};
+
+#endif // SOBEL_ASYNC_IO_H
@@ -0,0 +1,409 @@
+// Batch edge detection over many JPEGs with reads and writes overlapped with
+// compute: upcoming inputs are prefetched into memory (io_uring when built
+// with -DSOBEL_HAVE_LIBURING -luring), decoded with jpeg_mem_src, encoded
+// with jpeg_mem_dest, and written back on a background thread.
+//
+//   g++ -O3 -march=native -fopenmp sobel_batch.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_async_io.cpp sobel_sequence.cpp sobel_tuner.cpp sobel_cache.cpp -ljpeg -o sobel_batch
+//   ./sobel_batch [options] <output_dir> <input.jpg>...
+//
+// Options (one output mode at a time, plus --luma, --io, --cache and --tune):
+//   --tune               load this host's tuning profile, or auto-tune and
+//                        save one if there is none (--retune forces it)
+//   --luma <legacy|bt601|bt709|linear>
+//                        grayscale formula (default legacy, 0.3/0.59/0.11)
+//   --io <default|speed> libjpeg profile: speed decodes and encodes with the
+//                        IFAST DCT and no fancy upsampling or block smoothing
+//   --cache <dir>        answer inputs already processed with the same
+//                        settings from an on-disk result cache, without
+//                        decoding them (not with --sequence)
+//   --cache-size <MB>    cache size limit, least recently used evicted (1024)
+//   --sequence           treat the inputs as consecutive frames from a fixed
+//                        camera and only recompute tiles that changed
+//   --pbm <threshold>    1-bit edge mask (magnitude > threshold) as PBM,
+//                        packed inside the Sobel pass
+//   --points <threshold> sparse (x, y, magnitude) records, .edgepts
+//   --runs <threshold>   per-row run-length spans (x, y, length), .edgerle
+//   --color <max|dizenzo> colour edges from per-channel gradients, combined
+//                        by maximum or by the Di Zenzo structure tensor
+//   --auto-pbm <otsu|p>  PBM mask with the threshold picked per image from
+//                        the magnitude histogram: Otsu's method, or the
+//                        magnitude at percentile p (e.g. 90)
+//
+// Sparse files are a 24-byte header (8-byte magic "SOBELPTS" or "SOBELRLE",
+// uint32 width, uint32 height, uint64 record count) followed by the
+// EdgePoint or EdgeRun records in row-major order, native byte order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <string>
+#include <vector>
+
+#include "sobel_async_io.h"
+#include "sobel_cache.h"
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_sequence.h"
+#include "sobel_tuner.h"
+
+#define PREFETCH_DEPTH 4
+#define WRITE_DEPTH 4
+#define OUTPUT_QUALITY 95
+#define DEFAULT_CACHE_MB 1024
+// Bump when the Sobel kernel or an output format changes, so older cache
+// entries stop matching.
+#define CACHE_FORMAT_VERSION 1
+
+typedef enum {
+    OUTPUT_JPEG,
+    OUTPUT_SEQUENCE,
+    OUTPUT_COLOR,
+    OUTPUT_PBM,
+    OUTPUT_AUTO_PBM,
+    OUTPUT_POINTS,
+    OUTPUT_RUNS
+} OutputMode;
+
+static std::string outputPath(const std::string& dir, const std::string& input, const char* suffix) {
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos) {
+        name = name.substr(0, dot);
+    }
+    return dir + "/" + name + suffix;
+}
+
+static const char* outputSuffix(OutputMode mode) {
+    switch (mode) {
+    case OUTPUT_PBM:
+    case OUTPUT_AUTO_PBM:
+        return "_edge.pbm";
+    case OUTPUT_POINTS:
+        return "_edge.edgepts";
+    case OUTPUT_RUNS:
+        return "_edge.edgerle";
+    default:
+        return "_edge.jpg";
+    }
+}
+
+// Header plus records in one malloc'd buffer for the async writer.
+static uint8_t* packSparse(const char* magic, int width, int height,
+                           const void* records, size_t count, size_t record_size, size_t* size) {
+    const size_t header_size = 24;
+    *size = header_size + count * record_size;
+    uint8_t* buffer = (uint8_t*) malloc(*size);
+    if (!buffer) {
+        return NULL;
+    }
+    uint32_t dims[2] = {(uint32_t)width, (uint32_t)height};
+    uint64_t records_count = count;
+    memcpy(buffer, magic, 8);
+    memcpy(buffer + 8, dims, sizeof(dims));
+    memcpy(buffer + 16, &records_count, sizeof(records_count));
+    if (count > 0) {
+        memcpy(buffer + header_size, records, count * record_size);
+    }
+    return buffer;
+}
+
+int main(int argc, char** argv) {
+    int first_arg = 1;
+    OutputMode mode = OUTPUT_JPEG;
+    int threshold = 0;
+    double percentile = -1.0;
+    SobelColorMode color_mode = SOBEL_COLOR_MAX_CHANNEL;
+    bool bad_value = false;
+    SobelLumaFormula luma = SOBEL_LUMA_LEGACY;
+    JPEGIOOptions io_options = defaultJPEGIOOptions();
+    int tune = 0;  // 1: use or create the profile, 2: always re-tune
+    const char* cache_dir = NULL;
+    double cache_mb = DEFAULT_CACHE_MB;
+    int modes = 0;
+    while (first_arg < argc && strncmp(argv[first_arg], "--", 2) == 0) {
+        const char* option = argv[first_arg];
+        if (first_arg + 1 < argc && strcmp(option, "--luma") == 0) {
+            const char* name = argv[first_arg + 1];
+            if (strcmp(name, "bt601") == 0) {
+                luma = SOBEL_LUMA_BT601;
+            } else if (strcmp(name, "bt709") == 0) {
+                luma = SOBEL_LUMA_BT709;
+            } else if (strcmp(name, "linear") == 0) {
+                luma = SOBEL_LUMA_LINEAR;
+            } else if (strcmp(name, "legacy") != 0) {
+                bad_value = true;
+            }
+            first_arg += 2;
+            continue;
+        }
+        if (first_arg + 1 < argc && strcmp(option, "--io") == 0) {
+            if (strcmp(argv[first_arg + 1], "speed") == 0) {
+                io_options = speedJPEGIOOptions();
+            } else if (strcmp(argv[first_arg + 1], "default") != 0) {
+                bad_value = true;
+            }
+            first_arg += 2;
+            continue;
+        }
+        if (first_arg + 1 < argc && strcmp(option, "--cache") == 0) {
+            cache_dir = argv[first_arg + 1];
+            first_arg += 2;
+            continue;
+        }
+        if (first_arg + 1 < argc && strcmp(option, "--cache-size") == 0) {
+            cache_mb = atof(argv[first_arg + 1]);
+            bad_value = bad_value || cache_mb <= 0.0;
+            first_arg += 2;
+            continue;
+        }
+        if (strcmp(option, "--tune") == 0 || strcmp(option, "--retune") == 0) {
+            tune = strcmp(option, "--tune") == 0 ? 1 : 2;
+            first_arg++;
+            continue;
+        }
+        if (strcmp(option, "--sequence") == 0) {
+            mode = OUTPUT_SEQUENCE;
+            first_arg++;
+        } else if (first_arg + 1 < argc &&
+                   (strcmp(option, "--pbm") == 0 || strcmp(option, "--points") == 0 ||
+                    strcmp(option, "--runs") == 0)) {
+            mode = strcmp(option, "--pbm") == 0 ? OUTPUT_PBM
+                 : strcmp(option, "--points") == 0 ? OUTPUT_POINTS : OUTPUT_RUNS;
+            threshold = atoi(argv[first_arg + 1]);
+            first_arg += 2;
+        } else if (first_arg + 1 < argc && strcmp(option, "--color") == 0) {
+            mode = OUTPUT_COLOR;
+            if (strcmp(argv[first_arg + 1], "dizenzo") == 0) {
+                color_mode = SOBEL_COLOR_DI_ZENZO;
+            } else if (strcmp(argv[first_arg + 1], "max") != 0) {
+                bad_value = true;
+            }
+            first_arg += 2;
+        } else if (first_arg + 1 < argc && strcmp(option, "--auto-pbm") == 0) {
+            mode = OUTPUT_AUTO_PBM;
+            // A negative percentile selects Otsu.
+            percentile = strcmp(argv[first_arg + 1], "otsu") == 0 ? -1.0 : atof(argv[first_arg + 1]);
+            first_arg += 2;
+        } else {
+            break;
+        }
+        modes++;
+    }
+    if (argc < first_arg + 2 || modes > 1 || bad_value || threshold < 0 || threshold > 255 || percentile > 100.0) {
+        fprintf(stderr, "Usage: %s [--luma <legacy|bt601|bt709|linear>] [--io <default|speed>] [--tune | --retune]\n"
+                        "           [--cache <dir> [--cache-size <MB>]]\n"
+                        "           [--sequence | --color <max|dizenzo> | --pbm <t> | --auto-pbm <otsu|p> |\n"
+                        "           --points <t> | --runs <t>] <output_dir> <input.jpg>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::string output_dir = argv[first_arg];
+    std::vector<std::string> inputs(argv + first_arg + 1, argv + argc);
+
+    setJPEGIOOptions(io_options);
+    EdgeDetector detector;
+    detector.setLuma(luma);
+    if (tune) {
+        EdgeTuning tuning;
+        if (loadOrAutoTune(&tuning, tune == 2, true) == 0) {
+            detector.setTuning(tuning);
+        }
+    }
+    // Sequence output depends on the previous frames, not just this input.
+    ResultCache cache;
+    if (cache_dir && mode != OUTPUT_SEQUENCE && cache.open(cache_dir, (uint64_t)(cache_mb * 1024 * 1024)) != 0) {
+        return EXIT_FAILURE;
+    }
+    // Everything besides the input bytes that the output depends on; the
+    // tuning is left out because every tuned path gives identical output.
+    char cache_parameters[256];
+    snprintf(cache_parameters, sizeof(cache_parameters),
+             "v%d sobel3x3 mode=%d threshold=%d percentile=%g color=%d luma=%d dct=%d fancy=%d smoothing=%d "
+             "optimize=%d quality=%d", CACHE_FORMAT_VERSION, (int)mode, threshold, percentile, (int)color_mode,
+             (int)luma, (int)io_options.dct, io_options.fancy_upsampling, io_options.block_smoothing,
+             io_options.optimize_coding, OUTPUT_QUALITY);
+    double cache_time = 0.0;
+    int computed = 0;
+    SequenceEdgeDetector sequence_detector;
+    double skipped_total = 0.0;
+    size_t records_total = 0;
+    double threshold_total = 0.0;
+    int frames = 0;
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    std::vector<uint8_t> edges;
+    double wait_time = 0.0, decode_time = 0.0, edge_time = 0.0, encode_time = 0.0;
+    int failures = 0;
+
+    double start = omp_get_wtime();
+    {
+        FilePrefetcher prefetcher(inputs, PREFETCH_DEPTH);
+        AsyncWriter writer(WRITE_DEPTH);
+        FileData file;
+
+        while (true) {
+            double t0 = omp_get_wtime();
+            if (!prefetcher.next(&file)) {
+                break;
+            }
+            double t1 = omp_get_wtime();
+            wait_time += t1 - t0;
+
+            const char* suffix = outputSuffix(mode);
+            std::string cache_key;
+            if (cache.isOpen() && file.status == 0) {
+                cache_key = ResultCache::makeKey(file.data, file.size, cache_parameters);
+                uint8_t* cached;
+                size_t cached_size;
+                bool hit = cache.lookup(cache_key, &cached, &cached_size);
+                cache_time += omp_get_wtime() - t1;
+                if (hit) {
+                    if ((mode == OUTPUT_POINTS || mode == OUTPUT_RUNS) && cached_size >= 24) {
+                        uint64_t count;
+                        memcpy(&count, cached + 16, sizeof(count));
+                        records_total += count;
+                    }
+                    releaseFileData(&file);
+                    frames++;
+                    writer.submit(outputPath(output_dir, file.path, suffix), cached, cached_size);
+                    continue;
+                }
+                t1 = omp_get_wtime();
+            }
+
+            if (file.status != 0 || decodeJPEGMemory(file.data, file.size, &rgb) != 0) {
+                fprintf(stderr, "Error: Unable to decode %s.\n", file.path.c_str());
+                releaseFileData(&file);
+                failures++;
+                continue;
+            }
+            releaseFileData(&file);
+            double t2 = omp_get_wtime();
+            decode_time += t2 - t1;
+
+            int width = rgb.width;
+            int height = rgb.height;
+            size_t stride = (size_t)width * 3;
+            uint8_t* output = NULL;
+            size_t output_size = 0;
+            int status = 0;
+
+            if (mode == OUTPUT_PBM || mode == OUTPUT_AUTO_PBM) {
+                // Header and packed rows share one buffer handed to the writer.
+                char header[64];
+                int header_length = formatPBMHeader(header, sizeof(header), width, height);
+                size_t row_bytes = ((size_t)width + 7) / 8;
+                output_size = header_length + row_bytes * height;
+                output = (uint8_t*) malloc(output_size);
+                if (!output) {
+                    status = -1;
+                } else {
+                    memcpy(output, header, header_length);
+                    if (mode == OUTPUT_PBM) {
+                        status = detector.processBinary(rgb.data, stride, width, height, threshold,
+                                                        output + header_length, row_bytes);
+                    } else {
+                        int chosen = 0;
+                        status = detector.processAutoBinary(rgb.data, stride, width, height, percentile,
+                                                            output + header_length, row_bytes, &chosen);
+                        threshold_total += status == 0 ? chosen : 0;
+                    }
+                }
+                edge_time += omp_get_wtime() - t2;
+            } else if (mode == OUTPUT_POINTS) {
+                const EdgePoint* points;
+                size_t count;
+                status = detector.processPoints(rgb.data, stride, width, height, threshold, &points, &count);
+                edge_time += omp_get_wtime() - t2;
+                if (status == 0) {
+                    output = packSparse("SOBELPTS", width, height, points, count, sizeof(EdgePoint), &output_size);
+                    records_total += count;
+                }
+            } else if (mode == OUTPUT_RUNS) {
+                const EdgeRun* runs;
+                size_t count;
+                status = detector.processRuns(rgb.data, stride, width, height, threshold, &runs, &count);
+                edge_time += omp_get_wtime() - t2;
+                if (status == 0) {
+                    output = packSparse("SOBELRLE", width, height, runs, count, sizeof(EdgeRun), &output_size);
+                    records_total += count;
+                }
+            } else {
+                const uint8_t* edge_map;
+                if (mode == OUTPUT_SEQUENCE) {
+                    edge_map = sequence_detector.processFrame(rgb.data, stride, width, height);
+                    status = edge_map ? 0 : -1;
+                    skipped_total += edge_map ? sequence_detector.lastStats().skipped_fraction : 0.0;
+                } else if (mode == OUTPUT_COLOR) {
+                    edges.resize((size_t)width * height);
+                    status = detector.processColor(rgb.data, stride, width, height, color_mode, edges.data());
+                    edge_map = edges.data();
+                } else {
+                    edges.resize((size_t)width * height);
+                    status = detector.process(rgb.data, stride, width, height, edges.data());
+                    edge_map = edges.data();
+                }
+                double t3 = omp_get_wtime();
+                edge_time += t3 - t2;
+                if (status == 0 &&
+                    encodeGrayJPEGMemory(edge_map, width, height, OUTPUT_QUALITY, &output, &output_size) != 0) {
+                    output = NULL;
+                }
+                encode_time += omp_get_wtime() - t3;
+            }
+
+            // A failed pass leaves the buffer unwritten: it must not reach
+            // the output directory, the counts or the result cache.
+            if (status != 0 || !output) {
+                fprintf(stderr, "Error: Edge detection failed for %s.\n", file.path.c_str());
+                free(output);
+                failures++;
+                continue;
+            }
+            frames++;
+            computed++;
+            if (!cache_key.empty()) {
+                double t4 = omp_get_wtime();
+                cache.store(cache_key, output, output_size);
+                cache_time += omp_get_wtime() - t4;
+            }
+            writer.submit(outputPath(output_dir, file.path, suffix), output, output_size);
+        }
+        failures += writer.drain();
+    }
+    double total = omp_get_wtime() - start;
+
+    printf("Images: %zu (%d failed)\n", inputs.size(), failures);
+    printf("Time waiting for input: %f seconds\n", wait_time);
+    printf("Time taken for decode: %f seconds\n", decode_time);
+    printf("Time taken for edge detection: %f seconds\n", edge_time);
+    printf("Time taken for encode: %f seconds\n", encode_time);
+    if (cache.isOpen()) {
+        printf("Time taken for cache lookups and stores: %f seconds\n", cache_time);
+    }
+    printf("Total time: %f seconds\n", total);
+    if (mode == OUTPUT_SEQUENCE && frames > 0) {
+        printf("Tiles skipped: %.1f%%\n", 100.0 * skipped_total / frames);
+    }
+    // Thresholds of cache hits are not known, so the mean is over the
+    // images actually computed.
+    if (mode == OUTPUT_AUTO_PBM && computed > 0) {
+        printf("Mean threshold: %.1f\n", threshold_total / computed);
+    }
+    if (mode == OUTPUT_POINTS || mode == OUTPUT_RUNS) {
+        printf("Records written: %zu\n", records_total);
+    }
+    if (cache.isOpen()) {
+        const ResultCacheStats& stats = cache.stats();
+        uint64_t lookups = stats.hits + stats.misses;
+        printf("Cache: %llu hits, %llu misses (%.1f%% hit rate), %llu stored, %llu evicted, "
+               "%zu entries, %.1f MB\n", (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+               lookups ? 100.0 * stats.hits / lookups : 0.0, (unsigned long long)stats.stores,
+               (unsigned long long)stats.evictions, stats.entries, stats.bytes / (1024.0 * 1024.0));
+    }
+
+    freeImageBuffer(&rgb);
+    return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,270 @@
+// Stage benchmark for the OpenMP engine: the grayscale and Sobel passes of
+// EdgeDetector::process() (the benchmark programs' grayscaleConversion and
+// sobelEdgeDetection), timed separately. With --perf each thread also
+// reads its hardware counters (sobel_perf.h) around each stage, and the
+// achieved bandwidth is compared with a STREAM triad measured on the same
+// threads, to show whether a stage is memory- or compute-bound. --stream
+// writes both stages' output rows with non-temporal stores
+// (convertRowStream, sobelRowStream); run with and without it to compare
+// LLC misses, DRAM bytes and throughput.
+//
+//   g++ -O3 -march=native -fopenmp sobel_bench.cpp sobel_jpeg_io.cpp sobel_perf.cpp sobel_synthetic.cpp -ljpeg -o sobel_bench
+//   ./sobel_bench [--perf] [--stream] <input.jpg | synthetic:<pattern>:<W>x<H>> [repeats]
+//
+// Hardware counters need perf_event_paranoid <= 2 (<= 0 for the memory
+// controller counters) and a PMU; unavailable counters print as n/a.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <vector>
+
+#include "sobel_jpeg_io.h"
+#include "sobel_kernels.h"
+#include "sobel_perf.h"
+#include "sobel_synthetic.h"
+
+#define STAGE_COUNT 2
+#define STREAM_ELEMENTS (1 << 24)
+// Bytes each stage must move per pixel: grayscale reads 3 and writes 1;
+// Sobel reads 1 (the neighbour rows come from cache) and writes 1.
+#define GRAY_BYTES_PER_PIXEL 4.0
+#define SOBEL_BYTES_PER_PIXEL 2.0
+// Above this fraction of STREAM a stage is treated as memory-bound.
+#define MEMORY_BOUND_FRACTION 0.7
+
+static const char* const stage_names[STAGE_COUNT] = {"grayscaleConversion", "sobelEdgeDetection"};
+
+static void emptySample(PerfSample* sample) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        sample->values[i] = 0;
+        sample->valid[i] = true;
+    }
+}
+
+// Value per pixel, or n/a.
+static void printPerPixel(const PerfSample& sample, PerfCounterId id, double pixels) {
+    if (sample.valid[id]) {
+        printf(" %12.3f", sample.values[id] / pixels);
+    } else {
+        printf(" %12s", "n/a");
+    }
+}
+
+int main(int argc, char** argv) {
+    int first_arg = 1;
+    bool perf = false;
+    bool stream_stores = false;
+    for (; first_arg < argc && strncmp(argv[first_arg], "--", 2) == 0; first_arg++) {
+        if (strcmp(argv[first_arg], "--perf") == 0) {
+            perf = true;
+        } else if (strcmp(argv[first_arg], "--stream") == 0) {
+            stream_stores = true;
+        } else {
+            break;
+        }
+    }
+    if (argc < first_arg + 1 || strncmp(argv[first_arg], "--", 2) == 0) {
+        fprintf(stderr, "Usage: %s [--perf] [--stream] <input.jpg | synthetic:<pattern>:<W>x<H>> [repeats]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int repeats = argc > first_arg + 1 ? atoi(argv[first_arg + 1]) : 10;
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    if (loadImageOrSynthetic(argv[first_arg], &rgb) != 0) {
+        return EXIT_FAILURE;
+    }
+    const int width = rgb.width;
+    const int height = rgb.height;
+    const size_t stride = (size_t)width * 3;
+    const double pixels = (double)width * height * repeats;
+    if (width < 3 || height < 3) {
+        fprintf(stderr, "Error: image too small.\n");
+        freeImageBuffer(&rgb);
+        return EXIT_FAILURE;
+    }
+    std::vector<uint8_t> gray((size_t)width * height);
+    std::vector<uint8_t> edges((size_t)width * height, 0);
+    const int threads = omp_get_max_threads();
+
+    double stream = 0.0;
+    MemoryTraffic traffic;
+    if (perf) {
+        stream = measureStreamTriad(STREAM_ELEMENTS, threads);
+        traffic.open();
+    }
+
+    // [thread][stage] counter totals over all repeats.
+    std::vector<PerfSample> totals((size_t)threads * STAGE_COUNT);
+    for (size_t i = 0; i < totals.size(); i++) {
+        emptySample(&totals[i]);
+    }
+    double stage_time[STAGE_COUNT] = {0.0, 0.0};
+    uint64_t stage_bytes[STAGE_COUNT] = {0, 0};
+    int counters_opened = 0;
+
+    const uint8_t* image = rgb.data;
+    uint8_t* gray_data = gray.data();
+    uint8_t* edge_data = edges.data();
+    for (int repeat = 0; repeat < repeats; repeat++) {
+        double t0 = 0.0, t1 = 0.0, t2 = 0.0;
+        uint64_t dram0 = 0, dram1 = 0, dram2 = 0;
+
+        #pragma omp parallel num_threads(threads) reduction(max:counters_opened)
+        {
+            int tid = omp_get_thread_num();
+            ThreadCounters counters;
+            if (perf) {
+                counters_opened = counters.open();
+            }
+            PerfSample s0, s1, s2, s3;
+
+            #pragma omp single
+            {
+                dram0 = traffic.available() ? traffic.bytes() : 0;
+                t0 = omp_get_wtime();
+            }
+            counters.read(&s0);
+            #pragma omp for schedule(static) nowait
+            for (int y = 0; y < height; y++) {
+                if (stream_stores) {
+                    convertRowStream(image + (size_t)y * stride, gray_data + (size_t)y * width, width,
+                                     grayscaleRow);
+                } else {
+                    grayscaleRow(image + (size_t)y * stride, gray_data + (size_t)y * width, width);
+                }
+            }
+            if (stream_stores) {
+                streamFence();
+            }
+            counters.read(&s1);
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                t1 = omp_get_wtime();
+                dram1 = traffic.available() ? traffic.bytes() : 0;
+            }
+            // Sample again past the barriers so time spent waiting there for
+            // the slowest grayscale thread is not charged to the Sobel stage.
+            counters.read(&s2);
+            #pragma omp for schedule(static) nowait
+            for (int y = 1; y < height - 1; y++) {
+                const uint8_t* up = gray_data + (size_t)(y - 1) * width;
+                if (stream_stores) {
+                    sobelRowStream(up, up + width, up + 2 * width, edge_data + (size_t)y * width, width);
+                } else {
+                    sobelRow(up, up + width, up + 2 * width, edge_data + (size_t)y * width, width);
+                }
+            }
+            if (stream_stores) {
+                streamFence();
+            }
+            counters.read(&s3);
+            #pragma omp barrier
+
+            #pragma omp single
+            {
+                t2 = omp_get_wtime();
+                dram2 = traffic.available() ? traffic.bytes() : 0;
+            }
+            if (perf) {
+                perfAccumulate(&totals[(size_t)tid * STAGE_COUNT], perfDelta(s0, s1));
+                perfAccumulate(&totals[(size_t)tid * STAGE_COUNT + 1], perfDelta(s2, s3));
+            }
+        }
+        stage_time[0] += t1 - t0;
+        stage_time[1] += t2 - t1;
+        stage_bytes[0] += dram1 - dram0;
+        stage_bytes[1] += dram2 - dram1;
+    }
+
+    printf("Image %dx%d, %d thread(s), %d repeat(s), %s stores\n", width, height, threads, repeats,
+           stream_stores ? "streaming" : "cached");
+    printf("Time taken for grayscale conversion: %f seconds\n", stage_time[0] / repeats);
+    printf("Time taken for edge detection: %f seconds\n", stage_time[1] / repeats);
+
+    if (perf) {
+        const double nominal[STAGE_COUNT] = {GRAY_BYTES_PER_PIXEL, SOBEL_BYTES_PER_PIXEL};
+        printf("\nSTREAM triad peak: %.2f GB/s; %d of %d counters available per thread%s\n",
+               stream, counters_opened, PERF_COUNTER_COUNT,
+               traffic.available() ? "; DRAM traffic from uncore IMC" : "; no uncore IMC access");
+        printf("%-20s %8s %8s %6s %12s %12s %12s %12s %12s  %s\n", "stage", "GB/s", "%STREAM", "IPC",
+               "instr/px", "LLC-miss/px", "dTLB-miss/px", "DRAM B/px", "est. B/px", "bound");
+        for (int s = 0; s < STAGE_COUNT; s++) {
+            PerfSample stage;
+            emptySample(&stage);
+            for (int t = 0; t < threads; t++) {
+                perfAccumulate(&stage, totals[(size_t)t * STAGE_COUNT + s]);
+            }
+            double achieved = nominal[s] * pixels / stage_time[s] / 1e9;
+            double fraction = stream > 0.0 ? achieved / stream : 0.0;
+            printf("%-20s %8.2f %7.1f%%", stage_names[s], achieved, 100.0 * fraction);
+            if (stage.valid[PERF_CYCLES] && stage.valid[PERF_INSTRUCTIONS] && stage.values[PERF_CYCLES]) {
+                printf(" %6.2f", (double)stage.values[PERF_INSTRUCTIONS] / stage.values[PERF_CYCLES]);
+            } else {
+                printf(" %6s", "n/a");
+            }
+            printPerPixel(stage, PERF_INSTRUCTIONS, pixels);
+            printPerPixel(stage, PERF_LLC_MISSES, pixels);
+            printPerPixel(stage, PERF_DTLB_MISSES, pixels);
+            if (traffic.available()) {
+                printf(" %12.3f", stage_bytes[s] / pixels);
+            } else {
+                printf(" %12s", "n/a");
+            }
+            // Without the memory controller, each LLC miss is one 64-byte line.
+            if (stage.valid[PERF_LLC_MISSES]) {
+                printf(" %12.3f", stage.values[PERF_LLC_MISSES] * 64.0 / pixels);
+            } else {
+                printf(" %12s", "n/a");
+            }
+            printf("  %s\n", stream <= 0.0 ? "?" : fraction >= MEMORY_BOUND_FRACTION ? "memory" : "compute");
+        }
+
+        printf("\n%-6s %-20s %10s %14s %14s %6s %12s %12s\n", "thread", "stage", "cpu ms",
+               "cycles", "instructions", "IPC", "LLC-misses", "dTLB-misses");
+        for (int t = 0; t < threads; t++) {
+            for (int s = 0; s < STAGE_COUNT; s++) {
+                const PerfSample& sample = totals[(size_t)t * STAGE_COUNT + s];
+                printf("%-6d %-20s", t, stage_names[s]);
+                if (sample.valid[PERF_TASK_CLOCK]) {
+                    printf(" %10.3f", sample.values[PERF_TASK_CLOCK] / 1e6);
+                } else {
+                    printf(" %10s", "n/a");
+                }
+                const PerfCounterId ids[] = {PERF_CYCLES, PERF_INSTRUCTIONS};
+                for (int i = 0; i < 2; i++) {
+                    if (sample.valid[ids[i]]) {
+                        printf(" %14llu", (unsigned long long)sample.values[ids[i]]);
+                    } else {
+                        printf(" %14s", "n/a");
+                    }
+                }
+                if (sample.valid[PERF_CYCLES] && sample.valid[PERF_INSTRUCTIONS] && sample.values[PERF_CYCLES]) {
+                    printf(" %6.2f", (double)sample.values[PERF_INSTRUCTIONS] / sample.values[PERF_CYCLES]);
+                } else {
+                    printf(" %6s", "n/a");
+                }
+                const PerfCounterId misses[] = {PERF_LLC_MISSES, PERF_DTLB_MISSES};
+                for (int i = 0; i < 2; i++) {
+                    if (sample.valid[misses[i]]) {
+                        printf(" %12llu", (unsigned long long)sample.values[misses[i]]);
+                    } else {
+                        printf(" %12s", "n/a");
+                    }
+                }
+                printf("\n");
+            }
+        }
+    }
+
+    freeImageBuffer(&rgb);
+    return 0;
+}
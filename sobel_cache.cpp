@@ -0,0 +1,192 @@
+#include "sobel_cache.h"
+#include "sobel_hash.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <vector>
+
+#define ENTRY_SUFFIX ".out"
+#define HASH_LANES 4
+
+// Four independent hashRound lanes over 32-byte stripes, so the loop is not
+// one long dependency chain; several GB/s, which keeps the key far cheaper
+// than the decode it saves. Two differently ordered merges of the lanes give
+// the two halves of a 128-bit result.
+static void hashBytes(const uint8_t* data, size_t size, uint64_t seed, uint64_t out[2]) {
+    uint64_t lanes[HASH_LANES] = {seed + HASH_PRIME1, seed ^ HASH_PRIME2, seed - HASH_PRIME1,
+                                  seed * HASH_PRIME3 + 1};
+    size_t i = 0;
+    for (; i + 8 * HASH_LANES <= size; i += 8 * HASH_LANES) {
+        for (int l = 0; l < HASH_LANES; l++) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * l, 8);
+            lanes[l] = hashRound(lanes[l], word);
+        }
+    }
+    uint64_t tail = hashUpdate(HASH_PRIME3 ^ size, data + i, size - i);
+    uint64_t a = tail, b = ~tail;
+    for (int l = 0; l < HASH_LANES; l++) {
+        a = hashRound(a, lanes[l]);
+        b = hashRound(b, lanes[HASH_LANES - 1 - l]);
+    }
+    out[0] = hashFinal(a);
+    out[1] = hashFinal(b ^ out[0]);
+}
+
+ResultCache::ResultCache() : max_bytes_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+std::string ResultCache::makeKey(const uint8_t* input, size_t size, const std::string& parameters) {
+    uint64_t seed[2], hash[2];
+    hashBytes((const uint8_t*)parameters.data(), parameters.size(), 0, seed);
+    hashBytes(input, size, seed[0] ^ seed[1], hash);
+    char key[64];
+    snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long)hash[0], (unsigned long long)hash[1]);
+    return key;
+}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    return directory_ + "/" + key + ENTRY_SUFFIX;
+}
+
+int ResultCache::open(const std::string& directory, uint64_t max_bytes) {
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Unable to create cache directory %s.\n", directory.c_str());
+        return -1;
+    }
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) {
+        fprintf(stderr, "Error: Unable to open cache directory %s.\n", directory.c_str());
+        return -1;
+    }
+    directory_ = directory;
+    max_bytes_ = max_bytes;
+    lru_.clear();
+    entries_.clear();
+    memset(&stats_, 0, sizeof(stats_));
+
+    // Existing entries, most recently used (newest mtime) first.
+    struct Found {
+        std::string key;
+        uint64_t size;
+        struct timespec mtime;
+    };
+    std::vector<Found> found;
+    const size_t suffix_length = strlen(ENTRY_SUFFIX);
+    struct dirent* item;
+    while ((item = readdir(dir)) != NULL) {
+        size_t length = strlen(item->d_name);
+        if (length <= suffix_length || strcmp(item->d_name + length - suffix_length, ENTRY_SUFFIX) != 0) {
+            continue;
+        }
+        struct stat info;
+        std::string key(item->d_name, length - suffix_length);
+        if (stat(entryPath(key).c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            continue;
+        }
+        found.push_back(Found{key, (uint64_t)info.st_size, info.st_mtim});
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) {
+        return a.mtime.tv_sec != b.mtime.tv_sec ? a.mtime.tv_sec > b.mtime.tv_sec
+                                                : a.mtime.tv_nsec > b.mtime.tv_nsec;
+    });
+    for (size_t i = 0; i < found.size(); i++) {
+        lru_.push_back(found[i].key);
+        entries_[found[i].key] = Entry{found[i].size, std::prev(lru_.end())};
+        stats_.bytes += found[i].size;
+    }
+    stats_.entries = entries_.size();
+    evict(max_bytes_);
+    return 0;
+}
+
+bool ResultCache::lookup(const std::string& key, uint8_t** data, size_t* size) {
+    std::unordered_map<std::string, Entry>::iterator entry = entries_.find(key);
+    if (!isOpen() || entry == entries_.end()) {
+        stats_.misses++;
+        return false;
+    }
+    std::string path = entryPath(key);
+    FILE* file = fopen(path.c_str(), "rb");
+    uint8_t* buffer = file ? (uint8_t*) malloc(entry->second.size ? entry->second.size : 1) : NULL;
+    bool ok = buffer && fread(buffer, 1, entry->second.size, file) == entry->second.size;
+    if (file) {
+        fclose(file);
+    }
+    if (!ok) {
+        // Removed or truncated behind our back: forget it.
+        free(buffer);
+        stats_.bytes -= entry->second.size;
+        lru_.erase(entry->second.position);
+        entries_.erase(entry);
+        stats_.entries = entries_.size();
+        stats_.misses++;
+        return false;
+    }
+    // Refresh the mtime so the recency survives a restart.
+    utimensat(AT_FDCWD, path.c_str(), NULL, 0);
+    lru_.splice(lru_.begin(), lru_, entry->second.position);
+    stats_.hits++;
+    *data = buffer;
+    *size = entry->second.size;
+    return true;
+}
+
+int ResultCache::store(const std::string& key, const uint8_t* data, size_t size) {
+    if (!isOpen() || size > max_bytes_) {
+        return -1;
+    }
+    std::string path = entryPath(key);
+    char temporary[64];
+    snprintf(temporary, sizeof(temporary), ".tmp.%d", (int)getpid());
+    std::string temporary_path = path + temporary;
+    FILE* file = fopen(temporary_path.c_str(), "wb");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", temporary_path.c_str());
+        return -1;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary_path.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Error: Unable to finish writing %s.\n", path.c_str());
+        unlink(temporary_path.c_str());
+        return -1;
+    }
+
+    std::unordered_map<std::string, Entry>::iterator entry = entries_.find(key);
+    if (entry != entries_.end()) {
+        stats_.bytes -= entry->second.size;
+        lru_.erase(entry->second.position);
+        entries_.erase(entry);
+    }
+    lru_.push_front(key);
+    entries_[key] = Entry{size, lru_.begin()};
+    stats_.bytes += size;
+    stats_.entries = entries_.size();
+    stats_.stores++;
+    evict(max_bytes_);
+    return 0;
+}
+
+void ResultCache::evict(uint64_t limit) {
+    while (stats_.bytes > limit && !lru_.empty()) {
+        const std::string& key = lru_.back();
+        std::unordered_map<std::string, Entry>::iterator entry = entries_.find(key);
+        unlink(entryPath(key).c_str());
+        stats_.bytes -= entry->second.size;
+        entries_.erase(entry);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+    stats_.entries = entries_.size();
+}
@@ -0,0 +1,77 @@
+#ifndef SOBEL_CACHE_H
+#define SOBEL_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Content-addressed on-disk cache of finished outputs (encoded edge JPEGs,
+// PBM masks, sparse records). The key is a 128-bit hash of the compressed
+// input file plus a string of everything else the output depends on
+// (kernel, mode, threshold, luma formula, encoder settings), so a
+// resubmitted image is answered from disk without decoding it.
+//
+// Each entry is one file named after its key. Recency is the file's mtime,
+// which a hit refreshes, so the LRU order survives restarts and can be
+// shared by sequential runs. Writes go to a temporary name and are renamed
+// into place, so a reader never sees a partial entry. The cache is not
+// safe for concurrent use by several processes beyond that: two writers
+// may both evict, and the size accounting of each is its own.
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;
+    uint64_t bytes;    // current total size of the entries
+    size_t entries;
+} ResultCacheStats;
+
+class ResultCache {
+public:
+    ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Creates the directory if needed and indexes the entries already in
+    // it, evicting the least recently used beyond max_bytes. Returns 0 on
+    // success, -1 on failure (message on stderr).
+    int open(const std::string& directory, uint64_t max_bytes);
+    bool isOpen() const { return !directory_.empty(); }
+
+    // Hex key for an input file's bytes and the output parameters.
+    static std::string makeKey(const uint8_t* input, size_t size, const std::string& parameters);
+
+    // On a hit returns true with a malloc'd copy of the entry in *data
+    // (the caller frees it) and marks the entry most recently used.
+    bool lookup(const std::string& key, uint8_t** data, size_t* size);
+
+    // Adds or replaces an entry, then evicts LRU entries until the cache
+    // is within max_bytes. An entry larger than max_bytes is not stored.
+    // Returns 0 on success, -1 if the entry could not be written.
+    int store(const std::string& key, const uint8_t* data, size_t size);
+
+    const ResultCacheStats& stats() const { return stats_; }
+
+private:
+    struct Entry {
+        uint64_t size;
+        std::list<std::string>::iterator position;  // in lru_
+    };
+
+    std::string entryPath(const std::string& key) const;
+    void evict(uint64_t limit);
+
+    std::string directory_;
+    uint64_t max_bytes_;
+    // Most recently used first.
+    std::list<std::string> lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    ResultCacheStats stats_;
+};
+
+#endif // SOBEL_CACHE_H
@@ -0,0 +1,172 @@
+// Local client for sobel_daemon, standing in for a real service in tests.
+//
+//   g++ -O3 sobel_client.cpp sobel_jpeg_io.cpp -ljpeg -lrt -o sobel_client
+//   ./sobel_client /tmp/sobel.sock path Large_image.jpg Large_image_edge.jpg [repeat]
+//   ./sobel_client /tmp/sobel.sock shm Large_image.jpg Large_image_edge.jpg [repeat]
+//   ./sobel_client /tmp/sobel.sock tile Large_image.jpg <level> <tx> <ty> tile.jpg
+//   ./sobel_client /tmp/sobel.sock stats
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "sobel_daemon.h"
+#include "sobel_jpeg_io.h"
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Sends one request and copies the reply line into reply.
+static int request(const char* socket_path, const char* line, char* reply, size_t size) {
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    if (send(fd, line, strlen(line), MSG_NOSIGNAL) < 0) {
+        perror("send");
+        close(fd);
+        return -1;
+    }
+    size_t used = 0;
+    while (used + 1 < size) {
+        ssize_t got = recv(fd, reply + used, size - 1 - used, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        used += got;
+    }
+    reply[used] = '\0';
+    close(fd);
+    return strncmp(reply, "ERR", 3) == 0 || used == 0 ? -1 : 0;
+}
+
+// Copies the decoded image into a shm job object, lets the daemon fill in
+// the edge map, and encodes the result locally.
+static int runShm(const char* socket_path, const char* input, const char* output, int repeat) {
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    if (loadJPEGFile(input, &rgb) != 0) {
+        return -1;
+    }
+    int width = rgb.width;
+    int height = rgb.height;
+    size_t stride = (size_t)width * 3;
+    size_t size = shmJobSize(width, height, stride);
+
+    char name[64];
+    snprintf(name, sizeof(name), "/sobel_client_%d", (int)getpid());
+    int fd = shm_open(name, O_CREAT | O_RDWR | O_EXCL, 0600);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        perror("shm_open");
+        freeImageBuffer(&rgb);
+        return -1;
+    }
+    uint8_t* base = (uint8_t*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        shm_unlink(name);
+        freeImageBuffer(&rgb);
+        return -1;
+    }
+    memcpy(base, rgb.data, stride * height);
+    freeImageBuffer(&rgb);
+
+    char line[SOBEL_DAEMON_MAX_LINE];
+    char reply[256];
+    snprintf(line, sizeof(line), "SHM %s %d %d %zu\n", name, width, height, stride);
+    int status = 0;
+    for (int i = 0; i < repeat && status == 0; i++) {
+        double start = nowSeconds();
+        status = request(socket_path, line, reply, sizeof(reply));
+        printf("round trip %.0f us: %s", (nowSeconds() - start) * 1e6, reply);
+    }
+    if (status == 0) {
+        status = saveGrayJPEGFile(output, base + (size_t)height * stride, width, height, 95);
+    }
+    munmap(base, size);
+    shm_unlink(name);
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <socket_path> path|shm <input.jpg> <output.jpg> [repeat]\n"
+                        "       %s <socket_path> tile <input.jpg> <level> <tx> <ty> <output.jpg>\n"
+                        "       %s <socket_path> stats\n", argv[0], argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char* socket_path = argv[1];
+    const char* mode = argv[2];
+    char line[SOBEL_DAEMON_MAX_LINE];
+    char reply[256];
+
+    if (strcmp(mode, "stats") == 0) {
+        if (request(socket_path, "STATS\n", reply, sizeof(reply)) != 0) {
+            return EXIT_FAILURE;
+        }
+        printf("%s", reply);
+        return 0;
+    }
+    if (strcmp(mode, "tile") == 0) {
+        if (argc != 8) {
+            fprintf(stderr, "Error: tile mode needs <input.jpg> <level> <tx> <ty> <output.jpg>.\n");
+            return EXIT_FAILURE;
+        }
+        snprintf(line, sizeof(line), "TILE %s %s %s %s %s\n", argv[3], argv[4], argv[5], argv[6], argv[7]);
+        double start = nowSeconds();
+        if (request(socket_path, line, reply, sizeof(reply)) != 0) {
+            fprintf(stderr, "%s", reply);
+            return EXIT_FAILURE;
+        }
+        printf("round trip %.0f us: %s", (nowSeconds() - start) * 1e6, reply);
+        return 0;
+    }
+    if (argc < 5) {
+        fprintf(stderr, "Error: %s mode needs <input.jpg> <output.jpg>.\n", mode);
+        return EXIT_FAILURE;
+    }
+    int repeat = argc > 5 ? atoi(argv[5]) : 1;
+    if (repeat <= 0) repeat = 1;
+
+    if (strcmp(mode, "shm") == 0) {
+        return runShm(socket_path, argv[3], argv[4], repeat) == 0 ? 0 : EXIT_FAILURE;
+    }
+    if (strcmp(mode, "path") != 0) {
+        fprintf(stderr, "Error: unknown mode %s.\n", mode);
+        return EXIT_FAILURE;
+    }
+    snprintf(line, sizeof(line), "PATH %s %s\n", argv[3], argv[4]);
+    for (int i = 0; i < repeat; i++) {
+        double start = nowSeconds();
+        if (request(socket_path, line, reply, sizeof(reply)) != 0) {
+            fprintf(stderr, "%s", reply);
+            return EXIT_FAILURE;
+        }
+        printf("round trip %.0f us: %s", (nowSeconds() - start) * 1e6, reply);
+    }
+    return 0;
+}
@@ -0,0 +1,567 @@
+// Long-running edge detection server.
+//
+// Keeps EdgeDetector instances (and their OpenMP teams) warm, reuses decode
+// and output buffers at their high-water mark, and serves jobs from a
+// bounded queue over a Unix domain socket. See sobel_daemon.h for the
+// request format.
+//
+//   g++ -O3 -march=native -fopenmp sobel_daemon.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_lazy.cpp sobel_pyramid.cpp sobel_synthetic.cpp -ljpeg -lrt -lpthread -o sobel_daemon
+//   ./sobel_daemon /tmp/sobel.sock [threads] [workers] [queue_depth] [socket_mode]
+//
+// The socket is created with mode 0600 (owner only) unless an octal
+// socket_mode is given: any client that can connect may have the daemon
+// read and write files with its permissions.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sobel_daemon.h"
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_lazy.h"
+
+#define DEFAULT_QUEUE_DEPTH 64
+#define LATENCY_WINDOW 4096
+#define OUTPUT_QUALITY 95
+// Images kept open for TILE requests, and the tile cache of each.
+#define TILE_SOURCES 4
+#define TILE_CACHE_MB 256
+// Connections still sending their request line, and how long they may take.
+#define MAX_PENDING_REQUESTS 256
+#define REQUEST_TIMEOUT_SECONDS 5.0
+#define DEFAULT_SOCKET_MODE 0600
+
+static volatile sig_atomic_t running = 1;
+
+static void handleSignal(int) {
+    running = 0;
+}
+
+static double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    int fd;
+    double enqueued;
+    char line[SOBEL_DAEMON_MAX_LINE];
+} Job;
+
+// Fixed-capacity FIFO. Producers never block: a full queue is reported back
+// to the client so load is shed at the socket instead of piling up.
+class JobQueue {
+public:
+    explicit JobQueue(size_t capacity) : capacity_(capacity), closed_(false) {}
+
+    bool tryPush(const Job& job) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || jobs_.size() >= capacity_) {
+            return false;
+        }
+        jobs_.push_back(job);
+        ready_.notify_one();
+        return true;
+    }
+
+    bool pop(Job* job) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return closed_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            return false;
+        }
+        *job = jobs_.front();
+        jobs_.pop_front();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        ready_.notify_all();
+    }
+
+    size_t depth() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return jobs_.size();
+    }
+
+private:
+    size_t capacity_;
+    bool closed_;
+    std::deque<Job> jobs_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+};
+
+// Request latency (queue wait + service) over the most recent jobs.
+class LatencyStats {
+public:
+    LatencyStats() : count_(0), failed_(0), rejected_(0), total_(0.0), max_(0.0) {}
+
+    void record(double queue_seconds, double service_seconds, bool ok) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        double latency = queue_seconds + service_seconds;
+        window_[count_ % LATENCY_WINDOW] = latency;
+        count_++;
+        if (!ok) {
+            failed_++;
+        }
+        total_ += latency;
+        max_ = std::max(max_, latency);
+    }
+
+    void reject() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rejected_++;
+    }
+
+    void format(char* out, size_t size, size_t queue_depth) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = std::min(count_, (size_t)LATENCY_WINDOW);
+        std::vector<double> sorted(window_, window_ + n);
+        std::sort(sorted.begin(), sorted.end());
+        double p50 = n ? sorted[n / 2] : 0.0;
+        double p99 = n ? sorted[std::min(n - 1, (n * 99) / 100)] : 0.0;
+        snprintf(out, size,
+                 "STATS requests=%zu failed=%zu rejected=%zu queued=%zu "
+                 "mean_us=%.0f p50_us=%.0f p99_us=%.0f max_us=%.0f\n",
+                 count_, failed_, rejected_, queue_depth,
+                 count_ ? total_ / count_ * 1e6 : 0.0, p50 * 1e6, p99 * 1e6, max_ * 1e6);
+    }
+
+private:
+    std::mutex mutex_;
+    double window_[LATENCY_WINDOW];
+    size_t count_;
+    size_t failed_;
+    size_t rejected_;
+    double total_;
+    double max_;
+};
+
+// Lazy tile engines for TILE requests, shared by all workers and keyed by
+// input path; the least recently used is closed beyond TILE_SOURCES.
+// Workers still holding a closed engine finish with it first.
+class TileSources {
+public:
+    explicit TileSources(int threads) : threads_(threads) {}
+
+    std::shared_ptr<LazyEdgeTiles> get(const std::string& path) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::list<std::shared_ptr<Source> >::iterator it = sources_.begin(); it != sources_.end(); ++it) {
+            if ((*it)->path == path) {
+                std::shared_ptr<Source> source = *it;
+                sources_.splice(sources_.end(), sources_, it);
+                // Another worker may still be decoding it.
+                opened_.wait(lock, [&source] { return !source->opening; });
+                return source->tiles;
+            }
+        }
+
+        // Only a placeholder is added under the lock, so requests for other
+        // images go on while this one decodes, and concurrent first
+        // requests for this one wait for it instead of decoding it again.
+        std::shared_ptr<Source> source = std::make_shared<Source>();
+        source->path = path;
+        source->opening = true;
+        sources_.push_back(source);
+        if (sources_.size() > TILE_SOURCES) {
+            sources_.pop_front();
+        }
+        lock.unlock();
+
+        std::shared_ptr<LazyEdgeTiles> tiles =
+            std::make_shared<LazyEdgeTiles>((size_t)TILE_CACHE_MB * 1024 * 1024, threads_, 1);
+        int status = tiles->open(path.c_str(), defaultPyramidOptions(PYRAMID_DZI));
+
+        lock.lock();
+        source->opening = false;
+        if (status == 0) {
+            source->tiles = tiles;
+        } else {
+            // Forget the failure so a later request tries again.
+            sources_.remove(source);
+        }
+        opened_.notify_all();
+        return source->tiles;
+    }
+
+private:
+    struct Source {
+        std::string path;
+        bool opening;
+        std::shared_ptr<LazyEdgeTiles> tiles;  // NULL while opening or if open failed
+    };
+
+    int threads_;
+    std::mutex mutex_;
+    std::condition_variable opened_;
+    std::list<std::shared_ptr<Source> > sources_;  // least recently used first
+};
+
+// Per-worker state. Buffers only ever grow, so after the largest image has
+// been seen once no request allocates.
+typedef struct {
+    EdgeDetector* detector;
+    ImageBuffer rgb;
+    uint8_t* edges;
+    size_t edges_capacity;
+} Worker;
+
+static int reserveEdges(Worker* worker, size_t bytes) {
+    if (bytes <= worker->edges_capacity) {
+        return 0;
+    }
+    uint8_t* edges = (uint8_t*) malloc(bytes);
+    if (!edges) {
+        return -1;
+    }
+    free(worker->edges);
+    worker->edges = edges;
+    worker->edges_capacity = bytes;
+    return 0;
+}
+
+static void sendLine(int fd, const char* line) {
+    size_t length = strlen(line);
+    while (length > 0) {
+        ssize_t sent = send(fd, line, length, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        line += sent;
+        length -= sent;
+    }
+}
+
+static int runPathJob(Worker* worker, const char* input, const char* output) {
+    if (loadJPEGFile(input, &worker->rgb) != 0) {
+        return -1;
+    }
+    int width = worker->rgb.width;
+    int height = worker->rgb.height;
+    if (reserveEdges(worker, (size_t)width * height) != 0) {
+        return -1;
+    }
+    if (worker->detector->process(worker->rgb.data, (size_t)width * 3, width, height, worker->edges) != 0) {
+        return -1;
+    }
+    return saveGrayJPEGFile(output, worker->edges, width, height, OUTPUT_QUALITY);
+}
+
+static int runShmJob(Worker* worker, const char* name, int width, int height, size_t stride) {
+    if (width <= 0 || height <= 0 || stride < (size_t)width * 3) {
+        return -1;
+    }
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t size = shmJobSize(width, height, stride);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < size) {
+        close(fd);
+        return -1;
+    }
+    uint8_t* base = (uint8_t*) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    int status = worker->detector->process(base, stride, width, height, base + (size_t)height * stride);
+    munmap(base, size);
+    return status;
+}
+
+static int runTileJob(TileSources* sources, const char* input, int level, int tx, int ty, const char* output) {
+    std::shared_ptr<LazyEdgeTiles> tiles = sources->get(input);
+    LazyTile tile;
+    if (!tiles || tiles->getTile(level, tx, ty, &tile) != 0) {
+        return -1;
+    }
+    return saveGrayJPEGFile(output, tile.pixels->data(), tile.region.width, tile.region.height, OUTPUT_QUALITY);
+}
+
+static void serveJob(Worker* worker, TileSources* sources, Job* job, LatencyStats* stats) {
+    double started = nowSeconds();
+    char* save = NULL;
+    char* command = strtok_r(job->line, " \t\r\n", &save);
+    int status = -1;
+
+    if (command && strcmp(command, "PATH") == 0) {
+        char* input = strtok_r(NULL, " \t\r\n", &save);
+        char* output = strtok_r(NULL, " \t\r\n", &save);
+        if (input && output) {
+            status = runPathJob(worker, input, output);
+        }
+    } else if (command && strcmp(command, "SHM") == 0) {
+        char* name = strtok_r(NULL, " \t\r\n", &save);
+        char* width = strtok_r(NULL, " \t\r\n", &save);
+        char* height = strtok_r(NULL, " \t\r\n", &save);
+        char* stride = strtok_r(NULL, " \t\r\n", &save);
+        if (name && width && height && stride) {
+            status = runShmJob(worker, name, atoi(width), atoi(height), strtoull(stride, NULL, 10));
+        }
+    } else if (command && strcmp(command, "TILE") == 0) {
+        char* input = strtok_r(NULL, " \t\r\n", &save);
+        char* level = strtok_r(NULL, " \t\r\n", &save);
+        char* tx = strtok_r(NULL, " \t\r\n", &save);
+        char* ty = strtok_r(NULL, " \t\r\n", &save);
+        char* output = strtok_r(NULL, " \t\r\n", &save);
+        if (input && level && tx && ty && output) {
+            status = runTileJob(sources, input, atoi(level), atoi(tx), atoi(ty), output);
+        }
+    }
+
+    double finished = nowSeconds();
+    double queue_seconds = started - job->enqueued;
+    double service_seconds = finished - started;
+    stats->record(queue_seconds, service_seconds, status == 0);
+
+    char reply[128];
+    if (status == 0) {
+        snprintf(reply, sizeof(reply), "OK %.0f %.0f\n", service_seconds * 1e6, queue_seconds * 1e6);
+    } else {
+        snprintf(reply, sizeof(reply), "ERR %s failed\n", command ? command : "request");
+    }
+    sendLine(job->fd, reply);
+    close(job->fd);
+}
+
+static void workerLoop(int threads, JobQueue* queue, LatencyStats* stats, TileSources* sources) {
+    Worker worker;
+    worker.detector = new EdgeDetector(threads);
+    initImageBuffer(&worker.rgb);
+    worker.edges = NULL;
+    worker.edges_capacity = 0;
+
+    Job job;
+    while (queue->pop(&job)) {
+        serveJob(&worker, sources, &job, stats);
+    }
+
+    delete worker.detector;
+    freeImageBuffer(&worker.rgb);
+    free(worker.edges);
+}
+
+// A connection whose request line has not fully arrived. The accept thread
+// polls all of them at once, so a client that connects and stays silent
+// holds only its own slot until REQUEST_TIMEOUT_SECONDS, never the others.
+typedef struct {
+    Job job;
+    size_t used;
+    double accepted;
+} PendingRequest;
+
+// Reads whatever has arrived on a pending connection. Returns 1 once the
+// request line is complete, 0 if more is to come and -1 if the client went
+// away without sending one.
+static int readPending(PendingRequest* pending) {
+    Job* job = &pending->job;
+    while (pending->used + 1 < sizeof(job->line)) {
+        ssize_t got = recv(job->fd, job->line + pending->used, sizeof(job->line) - 1 - pending->used, 0);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return 0;
+        }
+        if (got <= 0) {
+            break;
+        }
+        pending->used += got;
+        if (memchr(job->line + pending->used - got, '\n', got)) {
+            break;
+        }
+    }
+    job->line[pending->used] = '\0';
+    return pending->used > 0 ? 1 : -1;
+}
+
+static int openListener(const char* path, mode_t mode) {
+    struct sockaddr_un addr;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path %s is too long.\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // Only a stale socket is replaced: never a regular file, and never the
+    // socket of a daemon that is still answering.
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "Error: %s exists and is not a socket.\n", path);
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr*) &addr, sizeof(addr)) == 0;
+        if (probe >= 0) {
+            close(probe);
+        }
+        if (live) {
+            fprintf(stderr, "Error: another daemon is listening on %s.\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    // PATH and TILE write wherever the client asks, so the socket is created
+    // owner-only and then opened up to the requested mode.
+    mode_t old_mask = umask(0177);
+    int bound = bind(fd, (struct sockaddr*) &addr, sizeof(addr));
+    umask(old_mask);
+    if (bound != 0 || chmod(path, mode) != 0 || listen(fd, 128) != 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket_path> [threads] [workers] [queue_depth] [socket_mode]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char* socket_path = argv[1];
+    int threads = argc > 2 ? atoi(argv[2]) : omp_get_max_threads();
+    int workers = argc > 3 ? atoi(argv[3]) : 1;
+    int queue_depth = argc > 4 ? atoi(argv[4]) : DEFAULT_QUEUE_DEPTH;
+    long socket_mode = argc > 5 ? strtol(argv[5], NULL, 8) : DEFAULT_SOCKET_MODE;
+    if (threads <= 0) threads = omp_get_max_threads();
+    if (workers <= 0) workers = 1;
+    if (queue_depth <= 0) queue_depth = DEFAULT_QUEUE_DEPTH;
+    if (socket_mode <= 0 || socket_mode > 0777) socket_mode = DEFAULT_SOCKET_MODE;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int listener = openListener(socket_path, (mode_t)socket_mode);
+    if (listener < 0) {
+        return EXIT_FAILURE;
+    }
+
+    JobQueue queue(queue_depth);
+    LatencyStats stats;
+    int threads_per_worker = std::max(1, threads / workers);
+    TileSources sources(threads_per_worker);
+    std::vector<std::thread> pool;
+    for (int i = 0; i < workers; i++) {
+        pool.emplace_back(workerLoop, threads_per_worker, &queue, &stats, &sources);
+    }
+    printf("sobel_daemon listening on %s (%d workers x %d threads, queue %d)\n",
+           socket_path, workers, threads_per_worker, queue_depth);
+    fflush(stdout);
+
+    std::vector<PendingRequest> pending;
+    std::vector<struct pollfd> fds;
+    while (running) {
+        fds.assign(1, pollfd{listener, POLLIN, 0});
+        for (size_t i = 0; i < pending.size(); i++) {
+            fds.push_back(pollfd{pending[i].job.fd, POLLIN, 0});
+        }
+        if (poll(fds.data(), fds.size(), 200) < 0) {
+            continue;
+        }
+
+        // Complete request lines are dispatched; silent clients time out.
+        double now = nowSeconds();
+        size_t kept = 0;
+        for (size_t i = 0; i < pending.size(); i++) {
+            PendingRequest& request = pending[i];
+            int state = fds[i + 1].revents ? readPending(&request) : 0;
+            if (state == 0 && now - request.accepted < REQUEST_TIMEOUT_SECONDS) {
+                pending[kept++] = request;
+                continue;
+            }
+            Job& job = request.job;
+            if (state <= 0) {
+                close(job.fd);
+                continue;
+            }
+            // Workers reply with plain blocking sends.
+            fcntl(job.fd, F_SETFL, fcntl(job.fd, F_GETFL) & ~O_NONBLOCK);
+            if (strncmp(job.line, "STATS", 5) == 0) {
+                char reply[256];
+                stats.format(reply, sizeof(reply), queue.depth());
+                sendLine(job.fd, reply);
+                close(job.fd);
+                continue;
+            }
+            job.enqueued = now;
+            if (!queue.tryPush(job)) {
+                stats.reject();
+                sendLine(job.fd, "ERR queue full\n");
+                close(job.fd);
+            }
+        }
+        pending.resize(kept);
+
+        if (fds[0].revents & POLLIN) {
+            int client;
+            while ((client = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                if (pending.size() >= MAX_PENDING_REQUESTS) {
+                    stats.reject();
+                    sendLine(client, "ERR too many connections\n");
+                    close(client);
+                    continue;
+                }
+                PendingRequest request;
+                request.job.fd = client;
+                request.used = 0;
+                request.accepted = now;
+                pending.push_back(request);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < pending.size(); i++) {
+        close(pending[i].job.fd);
+    }
+    queue.close();
+    for (size_t i = 0; i < pool.size(); i++) {
+        pool[i].join();
+    }
+    close(listener);
+    unlink(socket_path);
+    return 0;
+}
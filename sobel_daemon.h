@@ -0,0 +1,26 @@
+#ifndef SOBEL_DAEMON_H
+#define SOBEL_DAEMON_H
+
+#include <stddef.h>
+
+// Wire protocol between sobel_daemon and its clients. One request line per
+// connection over a Unix domain socket, one reply line back.
+//
+//   PATH <input.jpg> <output.jpg>           decode, detect, encode
+//   SHM <name> <width> <height> <stride>    detect in a POSIX shm object
+//   TILE <input> <level> <tx> <ty> <output.jpg>
+//                                           one Deep Zoom edge tile, computed
+//                                           lazily and cached (sobel_lazy.h)
+//   STATS                                   latency summary
+//
+// Replies are "OK <service_us> <queue_us>", "STATS ..." or "ERR <reason>".
+
+#define SOBEL_DAEMON_MAX_LINE 4096
+
+// A SHM job object holds the RGB input rows (height * stride bytes) followed
+// by the packed width * height edge map the daemon writes back.
+static inline size_t shmJobSize(int width, int height, size_t stride) {
+    return (size_t)height * stride + (size_t)width * (size_t)height;
+}
+
+#endif // SOBEL_DAEMON_H
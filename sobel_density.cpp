@@ -0,0 +1,168 @@
+// Edge-density index (sobel_index.h): per-tile edge counts, mean and max
+// magnitude emitted by the Sobel pass, and O(1) rectangle queries on top.
+// Reports the cost of building the index against plain process(), lists
+// the busiest tiles, and checks random rectangle queries against a scan
+// of the full edge map.
+//
+//   g++ -O3 -march=native -fopenmp sobel_density.cpp sobel_index.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_synthetic.cpp -ljpeg -o sobel_density
+//   ./sobel_density [--tile n] [--threshold t] [--top k] [--queries n] <input.jpg | synthetic:<pattern>:<W>x<H>>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_index.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_synthetic.h"
+
+#define REPEATS 5
+
+// Edge pixels in a rectangle, by scanning the edge map.
+static uint64_t scanCount(const uint8_t* edges, int width, int x, int y, int w, int h, int threshold) {
+    uint64_t count = 0;
+    for (int row = y; row < y + h; row++) {
+        const uint8_t* line = edges + (size_t)row * width;
+        for (int col = x; col < x + w; col++) {
+            count += line[col] > threshold;
+        }
+    }
+    return count;
+}
+
+int main(int argc, char** argv) {
+    int tile_size = 32, threshold = 64, top = 5, queries = 1000;
+    int first_arg = 1;
+    bool ok = true;
+    while (ok && first_arg + 1 < argc && strncmp(argv[first_arg], "--", 2) == 0) {
+        const char* option = argv[first_arg];
+        int value = atoi(argv[first_arg + 1]);
+        if (strcmp(option, "--tile") == 0) {
+            tile_size = value;
+            ok = tile_size > 0 && tile_size <= SOBEL_INDEX_MAX_TILE;
+        } else if (strcmp(option, "--threshold") == 0) {
+            threshold = value;
+            ok = threshold >= 0 && threshold <= 255;
+        } else if (strcmp(option, "--top") == 0) {
+            top = value;
+            ok = top >= 0;
+        } else if (strcmp(option, "--queries") == 0) {
+            queries = value;
+            ok = queries >= 0;
+        } else {
+            ok = false;
+        }
+        first_arg += 2;
+    }
+    if (!ok || argc != first_arg + 1) {
+        fprintf(stderr, "Usage: %s [--tile n] [--threshold t] [--top k] [--queries n] "
+                        "<input.jpg | synthetic:<pattern>:<W>x<H>>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    if (loadImageOrSynthetic(argv[first_arg], &rgb) != 0) {
+        return EXIT_FAILURE;
+    }
+    const int width = rgb.width;
+    const int height = rgb.height;
+    const size_t stride = (size_t)width * 3;
+    std::vector<uint8_t> edges((size_t)width * height);
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    const int tiles_y = (height + tile_size - 1) / tile_size;
+    std::vector<EdgeTileSummary> tiles((size_t)tiles_x * tiles_y);
+
+    // Best of REPEATS after one warm-up each.
+    EdgeDetector detector;
+    double plain = HUGE_VAL, indexed = HUGE_VAL;
+    for (int r = 0; r <= REPEATS; r++) {
+        double start = omp_get_wtime();
+        detector.process(rgb.data, stride, width, height, edges.data());
+        double elapsed = omp_get_wtime() - start;
+        plain = r > 0 && elapsed < plain ? elapsed : plain;
+
+        start = omp_get_wtime();
+        if (detector.processIndexed(rgb.data, stride, width, height, threshold, tile_size, edges.data(),
+                                    tiles.data()) != 0) {
+            fprintf(stderr, "Error: processIndexed failed.\n");
+            freeImageBuffer(&rgb);
+            return EXIT_FAILURE;
+        }
+        elapsed = omp_get_wtime() - start;
+        indexed = r > 0 && elapsed < indexed ? elapsed : indexed;
+    }
+    freeImageBuffer(&rgb);
+
+    EdgeDensityIndex index;
+    double build_start = omp_get_wtime();
+    index.build(tiles.data(), width, height, tile_size);
+    double build = omp_get_wtime() - build_start;
+
+    printf("Image %dx%d, %dx%d tiles of %d px, threshold %d\n", width, height, tiles_x, tiles_y, tile_size,
+           threshold);
+    printf("Time taken for process(): %f seconds\n", plain);
+    printf("Time taken for processIndexed(): %f seconds (%+.1f%%)\n", indexed, 100.0 * (indexed / plain - 1.0));
+    printf("Time taken for summed-area tables: %f seconds\n", build);
+    printf("Edge density: %.2f%%\n", 100.0 * index.edgeDensity(0, 0, width, height));
+
+    std::vector<int> order(tiles.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    top = std::min(top, (int)order.size());
+    std::partial_sort(order.begin(), order.begin() + top, order.end(), [&tiles](int a, int b) {
+        return tiles[a].edge_count > tiles[b].edge_count;
+    });
+    for (int i = 0; i < top; i++) {
+        int tx = order[i] % tiles_x, ty = order[i] / tiles_x;
+        printf("  tile (%d, %d) at (%d, %d): %u edge pixels, mean %.1f, max %u\n", tx, ty, tx * tile_size,
+               ty * tile_size, tiles[order[i]].edge_count, index.tileMean(tx, ty), tiles[order[i]].max_magnitude);
+    }
+
+    // Random rectangles: half snapped to tile boundaries, which must be
+    // exact, and half arbitrary.
+    if (queries > 0) {
+        srand(1);
+        std::vector<int> rects((size_t)queries * 4);
+        for (int q = 0; q < queries; q++) {
+            int* r = &rects[(size_t)q * 4];
+            r[0] = rand() % width;
+            r[1] = rand() % height;
+            r[2] = 1 + rand() % (width - r[0]);
+            r[3] = 1 + rand() % (height - r[1]);
+            if (q % 2 == 0) {
+                r[0] -= r[0] % tile_size;
+                r[1] -= r[1] % tile_size;
+                r[2] = std::min(((r[2] + tile_size - 1) / tile_size) * tile_size, width - r[0]);
+                r[3] = std::min(((r[3] + tile_size - 1) / tile_size) * tile_size, height - r[1]);
+            }
+        }
+        std::vector<double> estimates(queries);
+        double start = omp_get_wtime();
+        for (int q = 0; q < queries; q++) {
+            const int* r = &rects[(size_t)q * 4];
+            estimates[q] = index.edgeDensity(r[0], r[1], r[2], r[3]);
+        }
+        double index_time = omp_get_wtime() - start;
+        double aligned_error = 0.0, unaligned_error = 0.0;
+        start = omp_get_wtime();
+        for (int q = 0; q < queries; q++) {
+            const int* r = &rects[(size_t)q * 4];
+            double truth = (double)scanCount(edges.data(), width, r[0], r[1], r[2], r[3], threshold) /
+                           ((double)r[2] * r[3]);
+            double& worst = q % 2 == 0 ? aligned_error : unaligned_error;
+            worst = std::max(worst, fabs(estimates[q] - truth));
+        }
+        double scan_time = omp_get_wtime() - start;
+        printf("%d queries: index %.3f us each, scan %.3f us each\n", queries, index_time / queries * 1e6,
+               scan_time / queries * 1e6);
+        printf("Largest density error: %.2g tile-aligned, %.2g unaligned\n", aligned_error, unaligned_error);
+    }
+    return 0;
+}
@@ -0,0 +1,1198 @@
+#include "sobel_edge_detector.h"
+#include "sobel_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include <new>
+
+#define BUFFER_ALIGNMENT 64
+// Interleaved copies of each thread's bins, so runs of equal magnitudes do
+// not serialize on one counter.
+#define HISTOGRAM_LANES 4
+// processBatch() splits an image into bands of about this many pixels; a
+// 256x256 thumbnail stays one work item.
+#define BATCH_UNIT_PIXELS (64 * 1024)
+// processIndexed() folds its 16-bit column sums into per-tile totals at
+// least this often: 257 * 255 is the largest sum that fits.
+#define INDEX_FOLD_ROWS 257
+
+static size_t alignUp(size_t size) {
+    return (size + BUFFER_ALIGNMENT - 1) & ~(size_t)(BUFFER_ALIGNMENT - 1);
+}
+
+EdgeDetector::EdgeDetector(int num_threads)
+    : num_threads_(num_threads > 0 ? num_threads : omp_get_max_threads()),
+      gray_(NULL),
+      gray_capacity_(0),
+      luma_(SOBEL_LUMA_LEGACY),
+      luma_linear_(NULL) {
+    luma_weights_[0] = luma_weights_[1] = luma_weights_[2] = 0;
+    luma_coefficients_[0] = luma_coefficients_[1] = luma_coefficients_[2] = 0.0;
+    tuning_.num_threads = num_threads_;
+    tuning_.schedule = SOBEL_SCHEDULE_STATIC;
+    tuning_.chunk = 0;
+    tuning_.band_rows = 0;
+    tuning_.streaming_stores = 0;
+    // Spin the team up once here so the first process() call does not pay
+    // for thread creation. The runtime keeps the threads between regions.
+    #pragma omp parallel num_threads(num_threads_)
+    {
+    }
+}
+
+EdgeDetector::~EdgeDetector() {
+    free(gray_);
+    free(luma_linear_);
+}
+
+int EdgeDetector::setTuning(const EdgeTuning& tuning) {
+    if (tuning.num_threads <= 0 || tuning.chunk < 0 || tuning.band_rows < 0 ||
+        (tuning.schedule != SOBEL_SCHEDULE_STATIC && tuning.schedule != SOBEL_SCHEDULE_DYNAMIC &&
+         tuning.schedule != SOBEL_SCHEDULE_GUIDED)) {
+        return -1;
+    }
+    tuning_ = tuning;
+    if (num_threads_ != tuning.num_threads) {
+        num_threads_ = tuning.num_threads;
+        #pragma omp parallel num_threads(num_threads_)
+        {
+        }
+    }
+    return 0;
+}
+
+int EdgeDetector::setLuma(SobelLumaFormula formula) {
+    static const double bt601[3] = {0.299, 0.587, 0.114};
+    static const double bt709[3] = {0.2126, 0.7152, 0.0722};
+    const double* coefficients = NULL;
+    switch (formula) {
+    case SOBEL_LUMA_LEGACY:
+        break;
+    case SOBEL_LUMA_BT601:
+        // 0.299, 0.587, 0.114 in 1/65536 units; the weights sum to 65536.
+        luma_weights_[0] = 19595;
+        luma_weights_[1] = 38470;
+        luma_weights_[2] = 7471;
+        coefficients = bt601;
+        break;
+    case SOBEL_LUMA_BT709:
+        luma_weights_[0] = 13933;
+        luma_weights_[1] = 46871;
+        luma_weights_[2] = 4732;
+        coefficients = bt709;
+        break;
+    case SOBEL_LUMA_LINEAR:
+        if (!luma_linear_) {
+            luma_linear_ = (LinearLumaTables*) malloc(sizeof(LinearLumaTables));
+            if (!luma_linear_) {
+                fprintf(stderr, "EdgeDetector: failed to allocate %zu bytes\n", sizeof(LinearLumaTables));
+                return -1;
+            }
+        }
+        buildLinearLumaTables(bt709, luma_linear_);
+        coefficients = bt709;
+        break;
+    default:
+        return -1;
+    }
+    if (coefficients) {
+        memcpy(luma_coefficients_, coefficients, sizeof(luma_coefficients_));
+    }
+    luma_ = formula;
+    return 0;
+}
+
+void EdgeDetector::lumaRow(const uint8_t* rgb, uint8_t* gray, int width) const {
+    if (luma_ == SOBEL_LUMA_LEGACY) {
+        grayscaleRow(rgb, gray, width);
+    } else if (luma_ == SOBEL_LUMA_LINEAR) {
+        lumaRowLinear(rgb, gray, width, luma_linear_);
+    } else {
+        lumaRowFixed(rgb, gray, width, luma_weights_);
+    }
+}
+
+template <typename Pixel>
+void EdgeDetector::lumaRowDeep(const Pixel* rgb, Pixel* gray, int width) const {
+    if (luma_ == SOBEL_LUMA_LEGACY) {
+        grayscaleRowT(rgb, gray, width);
+    } else if (luma_ == SOBEL_LUMA_LINEAR) {
+        lumaRowLinearT(rgb, gray, width, luma_coefficients_);
+    } else {
+        lumaRowWeightedT(rgb, gray, width, luma_coefficients_);
+    }
+}
+
+int EdgeDetector::reserve(int width, int height) {
+    if (width <= 0 || height <= 0) {
+        return -1;
+    }
+    return reserveBytes((size_t)width * (size_t)height);
+}
+
+// gray_ is shared by all pixel types, so its capacity is kept in bytes.
+int EdgeDetector::reserveBytes(size_t needed) {
+    if (needed <= gray_capacity_) {
+        return 0;
+    }
+    uint8_t* buffer = (uint8_t*) aligned_alloc(BUFFER_ALIGNMENT, alignUp(needed));
+    if (!buffer) {
+        fprintf(stderr, "EdgeDetector: failed to allocate %zu bytes\n", needed);
+        return -1;
+    }
+    free(gray_);
+    gray_ = buffer;
+    gray_capacity_ = needed;
+    return 0;
+}
+
+int EdgeDetector::process(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out) {
+    if (!rgb || !out || width <= 0 || height <= 0 || stride < (size_t)width * 3) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height);
+        return 0;
+    }
+    // Banded runs keep their grayscale in per-thread scratch instead.
+    if (tuning_.band_rows == 0 && reserve(width, height) != 0) {
+        return -1;
+    }
+
+    uint8_t* gray = gray_;
+
+    // The loops below use schedule(runtime); the tuned kind and chunk are
+    // installed for this call only.
+    omp_sched_t saved_kind;
+    int saved_chunk;
+    omp_get_schedule(&saved_kind, &saved_chunk);
+    omp_set_schedule(tuning_.schedule == SOBEL_SCHEDULE_DYNAMIC ? omp_sched_dynamic
+                     : tuning_.schedule == SOBEL_SCHEDULE_GUIDED ? omp_sched_guided : omp_sched_static,
+                     tuning_.chunk);
+
+    if (tuning_.band_rows > 0) {
+        processBands(rgb, stride, width, height, out);
+    } else {
+        // Both passes share one parallel region; the implicit barrier after
+        // the first loop makes every grayscale row visible before Sobel
+        // reads it.
+        #pragma omp parallel num_threads(num_threads_)
+        {
+            if (tuning_.streaming_stores) {
+                // Streamed rows are weakly ordered, so each thread fences its
+                // own stores before the barrier that publishes them.
+                #pragma omp for schedule(runtime) nowait
+                for (int y = 0; y < height; y++) {
+                    convertRowStream(rgb + (size_t)y * stride, gray + (size_t)y * width, width,
+                                     [this](const uint8_t* src, uint8_t* dst, int count) {
+                                         lumaRow(src, dst, count);
+                                     });
+                }
+                streamFence();
+                #pragma omp barrier
+            } else {
+                #pragma omp for schedule(runtime)
+                for (int y = 0; y < height; y++) {
+                    lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+                }
+            }
+
+            #pragma omp for schedule(runtime) nowait
+            for (int y = 1; y < height - 1; y++) {
+                const uint8_t* up = gray + (size_t)(y - 1) * width;
+                if (tuning_.streaming_stores) {
+                    sobelRowStream(up, up + width, up + 2 * width, out + (size_t)y * width, width);
+                } else {
+                    sobelRow(up, up + width, up + 2 * width, out + (size_t)y * width, width);
+                }
+            }
+            if (tuning_.streaming_stores) {
+                streamFence();
+            }
+        }
+    }
+    omp_set_schedule(saved_kind, saved_chunk);
+
+    memset(out, 0, width);
+    memset(out + (size_t)(height - 1) * width, 0, width);
+    return 0;
+}
+
+// Fused variant of process(): each work item is a band of output rows.
+// Its grayscale rows, plus one halo row above and below, are converted into
+// the thread's own scratch and filtered while still in cache, so gray_ is
+// never written. Halo rows are converted twice, once by each adjacent band.
+void EdgeDetector::processBands(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out) {
+    const int band = tuning_.band_rows;
+    const int bands = (height - 2 + band - 1) / band;
+    row_scratch_.resize(num_threads_);
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        std::vector<uint8_t>& scratch = row_scratch_[omp_get_thread_num()];
+        scratch.resize((size_t)(band + 2) * width);
+        uint8_t* gray = scratch.data();
+
+        #pragma omp for schedule(runtime)
+        for (int b = 0; b < bands; b++) {
+            int y0 = 1 + b * band;
+            int y1 = y0 + band < height - 1 ? y0 + band : height - 1;
+            for (int y = y0 - 1; y <= y1; y++) {
+                lumaRow(rgb + (size_t)y * stride, gray + (size_t)(y - y0 + 1) * width, width);
+            }
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* mid = gray + (size_t)(y - y0 + 1) * width;
+                if (tuning_.streaming_stores) {
+                    sobelRowStream(mid - width, mid, mid + width, out + (size_t)y * width, width);
+                } else {
+                    sobelRow(mid - width, mid, mid + width, out + (size_t)y * width, width);
+                }
+            }
+        }
+        // The scratch rows are reused and stay cached; only the output is
+        // streamed.
+        if (tuning_.streaming_stores) {
+            streamFence();
+        }
+    }
+}
+
+int EdgeDetector::processBatch(const SobelBatchItem* items, int count) {
+    if (!items || count < 0) {
+        return -1;
+    }
+    // Validate everything and lay out the work units before any output is
+    // written. batch_units_ keeps its capacity between calls.
+    batch_units_.clear();
+    int max_band = 0, max_width = 0;
+    for (int i = 0; i < count; i++) {
+        const SobelBatchItem& item = items[i];
+        if (!item.rgb || !item.out || item.width <= 0 || item.height <= 0 ||
+            item.stride < (size_t)item.width * 3) {
+            return -1;
+        }
+        if (item.width < 3 || item.height < 3) {
+            batch_units_.push_back(BatchUnit{i, 0, 0});
+            continue;
+        }
+        int band = BATCH_UNIT_PIXELS / item.width;
+        band = band < 1 ? 1 : band < item.height - 2 ? band : item.height - 2;
+        for (int y0 = 1; y0 < item.height - 1; y0 += band) {
+            int y1 = y0 + band < item.height - 1 ? y0 + band : item.height - 1;
+            batch_units_.push_back(BatchUnit{i, y0, y1});
+        }
+        max_band = band > max_band ? band : max_band;
+        max_width = item.width > max_width ? item.width : max_width;
+    }
+    const BatchUnit* units = batch_units_.data();
+    const int unit_count = (int)batch_units_.size();
+    row_scratch_.resize(num_threads_);
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        std::vector<uint8_t>& scratch = row_scratch_[omp_get_thread_num()];
+        if (scratch.size() < (size_t)(max_band + 2) * max_width) {
+            scratch.resize((size_t)(max_band + 2) * max_width);
+        }
+        uint8_t* gray = scratch.data();
+
+        #pragma omp for schedule(dynamic)
+        for (int u = 0; u < unit_count; u++) {
+            const SobelBatchItem& item = items[units[u].item];
+            const int width = item.width;
+            const int y0 = units[u].y0, y1 = units[u].y1;
+            if (y0 == y1) {
+                memset(item.out, 0, (size_t)width * item.height);
+                continue;
+            }
+            for (int y = y0 - 1; y <= y1; y++) {
+                lumaRow(item.rgb + (size_t)y * item.stride, gray + (size_t)(y - y0 + 1) * width, width);
+            }
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* mid = gray + (size_t)(y - y0 + 1) * width;
+                sobelRow(mid - width, mid, mid + width, item.out + (size_t)y * width, width);
+            }
+            // The bands touching the border also clear it.
+            if (y0 == 1) {
+                memset(item.out, 0, width);
+            }
+            if (y1 == item.height - 1) {
+                memset(item.out + (size_t)y1 * width, 0, width);
+            }
+        }
+    }
+    return 0;
+}
+
+int EdgeDetector::processInPlace(uint8_t* rgb, size_t stride, int width, int height) {
+    if (!rgb || width <= 0 || height <= 0 || stride < (size_t)width * 3) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        memset(rgb, 0, (size_t)width * height);
+        return 0;
+    }
+    uint8_t* plane = rgb;
+    row_scratch_.resize(num_threads_);
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        std::vector<uint8_t>& scratch = row_scratch_[omp_get_thread_num()];
+        scratch.resize((size_t)4 * width);
+
+        // Gray row 0 overlaps its own RGB row, so it goes through scratch.
+        #pragma omp single
+        {
+            lumaRow(rgb, scratch.data(), width);
+            memcpy(plane, scratch.data(), width);
+        }
+        // Then in waves: gray rows [a, b) land in bytes [a * width,
+        // b * width), which hold only RGB rows below a (already converted)
+        // as long as b * width <= a * stride. Each wave is about 3x the last.
+        for (int a = 1; a < height; ) {
+            size_t limit = (size_t)a * stride / width;
+            int b = limit < (size_t)height ? (int)limit : height;
+            #pragma omp for schedule(static)
+            for (int y = a; y < b; y++) {
+                lumaRow(rgb + (size_t)y * stride, plane + (size_t)y * width, width);
+            }
+            a = b;
+        }
+
+        // Edges over gray. Each thread owns a contiguous block [y0, y1) of
+        // interior rows. Writing edge row y destroys gray row y, so the
+        // stencil reads gray rows y - 1, y, y + 1 from a ring; row y1 belongs
+        // to the next block and is saved before anyone starts writing.
+        int tid = omp_get_thread_num();
+        int team = omp_get_num_threads();
+        int y0 = 1 + (int)((int64_t)(height - 2) * tid / team);
+        int y1 = 1 + (int)((int64_t)(height - 2) * (tid + 1) / team);
+        uint8_t* ring = scratch.data();
+        uint8_t* below = ring + (size_t)3 * width;
+        if (y0 < y1) {
+            memcpy(ring + (size_t)((y0 - 1) % 3) * width, plane + (size_t)(y0 - 1) * width, width);
+            memcpy(ring + (size_t)(y0 % 3) * width, plane + (size_t)y0 * width, width);
+            memcpy(below, plane + (size_t)y1 * width, width);
+        }
+        #pragma omp barrier
+        for (int y = y0; y < y1; y++) {
+            uint8_t* next = ring + (size_t)((y + 1) % 3) * width;
+            memcpy(next, y + 1 < y1 ? plane + (size_t)(y + 1) * width : below, width);
+            sobelRow(ring + (size_t)((y + 2) % 3) * width, ring + (size_t)(y % 3) * width, next,
+                     plane + (size_t)y * width, width);
+        }
+    }
+
+    memset(plane, 0, width);
+    memset(plane + (size_t)(height - 1) * width, 0, width);
+    return 0;
+}
+
+int EdgeDetector::processRegion(const uint8_t* rgb, size_t stride, int width, int height,
+                                int rx, int ry, int rw, int rh, uint8_t* out) {
+    if (!rgb || !out || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        rw <= 0 || rh <= 0 || rx < 0 || ry < 0 || rx + rw > width || ry + rh > height) {
+        return -1;
+    }
+
+    // Grayscale window: the rectangle plus its halo, clipped to the image.
+    int gx0 = rx > 0 ? rx - 1 : 0;
+    int gy0 = ry > 0 ? ry - 1 : 0;
+    int gx1 = rx + rw < width ? rx + rw + 1 : width;
+    int gy1 = ry + rh < height ? ry + rh + 1 : height;
+    int gw = gx1 - gx0;
+    if (reserve(gw, gy1 - gy0) != 0) {
+        return -1;
+    }
+
+    // Interior part of the rectangle; everything else is image border.
+    int x0 = rx > 1 ? rx : 1;
+    int x1 = rx + rw < width - 1 ? rx + rw : width - 1;
+    uint8_t* gray = gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        #pragma omp for schedule(static)
+        for (int y = gy0; y < gy1; y++) {
+            lumaRow(rgb + (size_t)y * stride + (size_t)gx0 * 3, gray + (size_t)(y - gy0) * gw, gw);
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = ry; y < ry + rh; y++) {
+            uint8_t* row = out + (size_t)(y - ry) * rw;
+            if (y == 0 || y == height - 1 || x0 >= x1) {
+                memset(row, 0, rw);
+                continue;
+            }
+            if (rx == 0) {
+                row[0] = 0;
+            }
+            if (rx + rw == width) {
+                row[rw - 1] = 0;
+            }
+            const uint8_t* mid = gray + (size_t)(y - gy0) * gw + (x0 - gx0);
+            sobelPixels(mid - gw, mid, mid + gw, row + (x0 - rx), x1 - x0);
+        }
+    }
+    return 0;
+}
+
+int EdgeDetector::processBinary(const uint8_t* rgb, size_t stride, int width, int height,
+                                int threshold, uint8_t* bits, size_t bits_stride) {
+    size_t row_bytes = ((size_t)width + 7) / 8;
+    if (!rgb || !bits || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        bits_stride < row_bytes || threshold < 0 || threshold > 255) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        for (int y = 0; y < height; y++) {
+            memset(bits + (size_t)y * bits_stride, 0, row_bytes);
+        }
+        return 0;
+    }
+    if (reserve(width, height) != 0) {
+        return -1;
+    }
+
+    uint8_t* gray = gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 1; y < height - 1; y++) {
+            sobelBinaryRow(gray + (size_t)(y - 1) * width,
+                           gray + (size_t)y * width,
+                           gray + (size_t)(y + 1) * width,
+                           bits + (size_t)y * bits_stride, width, threshold);
+        }
+    }
+
+    memset(bits, 0, row_bytes);
+    memset(bits + (size_t)(height - 1) * bits_stride, 0, row_bytes);
+    return 0;
+}
+
+// Appends the records for one filtered row.
+static inline void emitRow(const uint8_t* row, int y, int width, int threshold,
+                           std::vector<EdgePoint>& points) {
+    scanAbove(row, 1, width - 1, threshold, [&](int x) {
+        EdgePoint point = {(uint32_t)x, (uint32_t)y, row[x]};
+        points.push_back(point);
+    });
+}
+
+static inline void emitRow(const uint8_t* row, int y, int width, int threshold,
+                           std::vector<EdgeRun>& runs) {
+    EdgeRun run = {0, (uint32_t)y, 0};
+    scanAbove(row, 1, width - 1, threshold, [&](int x) {
+        if (run.length > 0 && run.x + run.length == (uint32_t)x) {
+            run.length++;
+            return;
+        }
+        if (run.length > 0) {
+            runs.push_back(run);
+        }
+        run.x = (uint32_t)x;
+        run.length = 1;
+    });
+    if (run.length > 0) {
+        runs.push_back(run);
+    }
+}
+
+template <typename Record>
+int EdgeDetector::processSparse(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                                std::vector<std::vector<Record> >& local, std::vector<Record>& merged) {
+    if (!rgb || width <= 0 || height <= 0 || stride < (size_t)width * 3 || threshold < 0 || threshold > 255) {
+        return -1;
+    }
+    merged.clear();
+    if (width < 3 || height < 3) {
+        return 0;
+    }
+    if (reserve(width, height) != 0) {
+        return -1;
+    }
+    local.resize(num_threads_);
+    row_scratch_.resize(num_threads_);
+
+    uint8_t* gray = gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        int tid = omp_get_thread_num();
+        std::vector<Record>& mine = local[tid];
+        std::vector<uint8_t>& row = row_scratch_[tid];
+        mine.clear();
+        row.resize(width);
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+        }
+
+        // Static scheduling gives each thread one contiguous, increasing
+        // block of rows, so thread order is row order.
+        #pragma omp for schedule(static)
+        for (int y = 1; y < height - 1; y++) {
+            sobelRow(gray + (size_t)(y - 1) * width,
+                     gray + (size_t)y * width,
+                     gray + (size_t)(y + 1) * width,
+                     row.data(), width);
+            emitRow(row.data(), y, width, threshold, mine);
+        }
+
+        #pragma omp single
+        {
+            size_t total = 0;
+            for (int t = 0; t < omp_get_num_threads(); t++) {
+                total += local[t].size();
+            }
+            merged.resize(total);
+        }
+
+        size_t offset = 0;
+        for (int t = 0; t < tid; t++) {
+            offset += local[t].size();
+        }
+        if (!mine.empty()) {
+            memcpy(merged.data() + offset, mine.data(), mine.size() * sizeof(Record));
+        }
+    }
+    return 0;
+}
+
+int EdgeDetector::processPoints(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                                const EdgePoint** points, size_t* count) {
+    int status = processSparse(rgb, stride, width, height, threshold, local_points_, points_);
+    *points = points_.data();
+    *count = points_.size();
+    return status;
+}
+
+int EdgeDetector::processRuns(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                              const EdgeRun** runs, size_t* count) {
+    int status = processSparse(rgb, stride, width, height, threshold, local_runs_, runs_);
+    *runs = runs_.data();
+    *count = runs_.size();
+    return status;
+}
+
+int EdgeDetector::processHistogram(const uint8_t* rgb, size_t stride, int width, int height,
+                                   uint8_t* out, EdgeHistogram* histogram, int bins) {
+    if (!rgb || !out || !histogram || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        (bins != 256 && bins != 1024)) {
+        return -1;
+    }
+    memset(histogram, 0, sizeof(*histogram));
+    histogram->bin_count = bins;
+    histogram->bin_width = bins == 256 ? 1 : 2;
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height);
+        return 0;
+    }
+    if (reserve(width, height) != 0) {
+        return -1;
+    }
+    local_bins_.resize(num_threads_);
+    raw_scratch_.resize(num_threads_);
+
+    uint8_t* gray = gray_;
+    uint64_t* totals = histogram->bins;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        int tid = omp_get_thread_num();
+        int team = omp_get_num_threads();
+        std::vector<uint32_t>& counts = local_bins_[tid];
+        std::vector<uint16_t>& raw = raw_scratch_[tid];
+        counts.assign((size_t)HISTOGRAM_LANES * bins, 0);
+        if (bins == 1024) {
+            raw.resize(width);
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 1; y < height - 1; y++) {
+            const uint8_t* up = gray + (size_t)(y - 1) * width;
+            const uint8_t* mid = gray + (size_t)y * width;
+            const uint8_t* down = gray + (size_t)(y + 1) * width;
+            uint8_t* row = out + (size_t)y * width;
+            if (bins == 256) {
+                sobelRow(up, mid, down, row, width);
+                for (int x = 1; x < width - 1; x++) {
+                    counts[(x & (HISTOGRAM_LANES - 1)) * 256 + row[x]]++;
+                }
+            } else {
+                // Count before clamping so the range above 255 is kept.
+                sobelPixelsRaw(up + 1, mid + 1, down + 1, raw.data(), width - 2);
+                row[0] = 0;
+                row[width - 1] = 0;
+                for (int i = 0; i < width - 2; i++) {
+                    int magnitude = raw[i];
+                    row[i + 1] = (uint8_t)(magnitude > 255 ? 255 : magnitude);
+                    counts[(i & (HISTOGRAM_LANES - 1)) * 1024 + (magnitude > 2047 ? 2047 : magnitude) / 2]++;
+                }
+            }
+        }
+
+        // Every thread's bins are final after the barrier above; reduce them
+        // with the bins split across the team.
+        #pragma omp for schedule(static)
+        for (int b = 0; b < bins; b++) {
+            uint64_t sum = 0;
+            for (int t = 0; t < team; t++) {
+                for (int lane = 0; lane < HISTOGRAM_LANES; lane++) {
+                    sum += local_bins_[t][(size_t)lane * bins + b];
+                }
+            }
+            totals[b] = sum;
+        }
+    }
+
+    histogram->total = (uint64_t)(width - 2) * (uint64_t)(height - 2);
+    memset(out, 0, width);
+    memset(out + (size_t)(height - 1) * width, 0, width);
+    return 0;
+}
+
+int EdgeDetector::processIndexed(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                                 int tile_size, uint8_t* out, EdgeTileSummary* tiles) {
+    if (!rgb || !out || !tiles || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        threshold < 0 || threshold > 255 || tile_size <= 0 || tile_size > SOBEL_INDEX_MAX_TILE) {
+        return -1;
+    }
+    const int tiles_x = (width + tile_size - 1) / tile_size;
+    const int tiles_y = (height + tile_size - 1) / tile_size;
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height);
+        memset(tiles, 0, sizeof(EdgeTileSummary) * tiles_x * tiles_y);
+        return 0;
+    }
+    if (reserve(width, height) != 0) {
+        return -1;
+    }
+    row_scratch_.resize(num_threads_);
+    uint8_t* gray = gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        // Per-column 16-bit count and sum and 8-bit max over the rows of
+        // the current band, updated by the Sobel kernel itself as each
+        // magnitude is computed (sobelRowsTally). They are folded into 32-bit
+        // per-tile totals at the end of the band, or every
+        // INDEX_FOLD_ROWS rows, before a 16-bit sum can overflow.
+        std::vector<uint8_t>& local = row_scratch_[omp_get_thread_num()];
+        local.resize((size_t)3 * sizeof(uint32_t) * tiles_x + (size_t)5 * width);
+        uint32_t* tile_counts = (uint32_t*) local.data();
+        uint32_t* tile_sums = tile_counts + tiles_x;
+        uint32_t* tile_maxima = tile_sums + tiles_x;
+        uint16_t* counts = (uint16_t*) (tile_maxima + tiles_x);
+        uint16_t* sums = counts + width;
+        uint8_t* maxima = (uint8_t*) (sums + width);
+
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+        }
+
+        #pragma omp for schedule(dynamic)
+        for (int ty = 0; ty < tiles_y; ty++) {
+            memset(tile_counts, 0, sizeof(uint32_t) * 3 * tiles_x);
+            int y0 = ty * tile_size;
+            int y1 = y0 + tile_size < height ? y0 + tile_size : height;
+            for (int f0 = y0; f0 < y1; f0 += INDEX_FOLD_ROWS) {
+                int f1 = f0 + INDEX_FOLD_ROWS < y1 ? f0 + INDEX_FOLD_ROWS : y1;
+                memset(counts, 0, (size_t)5 * width);
+                // The first and last image rows are border and stay 0.
+                int r0 = f0 > 1 ? f0 : 1;
+                int r1 = f1 < height - 1 ? f1 : height - 1;
+                if (f0 == 0) {
+                    memset(out, 0, width);
+                }
+                if (f1 == height) {
+                    memset(out + (size_t)(height - 1) * width, 0, width);
+                }
+                if (r0 < r1) {
+                    sobelRowsTally(gray + (size_t)(r0 - 1) * width, out + (size_t)r0 * width, width, r1 - r0,
+                                   (uint8_t)threshold, counts, sums, maxima);
+                }
+                for (int tx = 0; tx < tiles_x; tx++) {
+                    int x0 = tx * tile_size;
+                    int x1 = x0 + tile_size < width ? x0 + tile_size : width;
+                    uint32_t count = 0, sum = 0, peak = tile_maxima[tx];
+                    for (int x = x0; x < x1; x++) {
+                        count += counts[x];
+                        sum += sums[x];
+                        peak = maxima[x] > peak ? maxima[x] : peak;
+                    }
+                    tile_counts[tx] += count;
+                    tile_sums[tx] += sum;
+                    tile_maxima[tx] = peak;
+                }
+            }
+            EdgeTileSummary* summary = tiles + (size_t)ty * tiles_x;
+            for (int tx = 0; tx < tiles_x; tx++) {
+                summary[tx].edge_count = tile_counts[tx];
+                summary[tx].magnitude_sum = tile_sums[tx];
+                summary[tx].max_magnitude = (uint8_t)tile_maxima[tx];
+            }
+        }
+    }
+    return 0;
+}
+
+int EdgeDetector::processAutoBinary(const uint8_t* rgb, size_t stride, int width, int height, double percentile,
+                                    uint8_t* bits, size_t bits_stride, int* threshold_out) {
+    if (!bits || bits_stride < ((size_t)width + 7) / 8 || percentile > 100.0 || width <= 0 || height <= 0) {
+        return -1;
+    }
+    edges_scratch_.resize((size_t)width * height);
+    EdgeHistogram histogram;
+    if (processHistogram(rgb, stride, width, height, edges_scratch_.data(), &histogram, 256) != 0) {
+        return -1;
+    }
+    int threshold = percentile < 0.0 ? sobel_histogram_otsu(&histogram)
+                                     : sobel_histogram_percentile(&histogram, percentile);
+    if (threshold > 254) {
+        threshold = 254;
+    }
+
+    const uint8_t* edges = edges_scratch_.data();
+    #pragma omp parallel for schedule(static) num_threads(num_threads_)
+    for (int y = 0; y < height; y++) {
+        packAboveRow(edges + (size_t)y * width, bits + (size_t)y * bits_stride, width, threshold);
+    }
+
+    if (threshold_out) {
+        *threshold_out = threshold;
+    }
+    return 0;
+}
+
+int EdgeDetector::processGradients(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out,
+                                   int16_t* gx, int16_t* gy, size_t gradient_stride) {
+    if (!rgb || !gx || !gy || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        gradient_stride < (size_t)width) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        for (int y = 0; y < height; y++) {
+            memset(gx + (size_t)y * gradient_stride, 0, (size_t)width * sizeof(int16_t));
+            memset(gy + (size_t)y * gradient_stride, 0, (size_t)width * sizeof(int16_t));
+        }
+        if (out) {
+            memset(out, 0, (size_t)width * height);
+        }
+        return 0;
+    }
+    if (reserve(width, height) != 0) {
+        return -1;
+    }
+
+    uint8_t* gray = gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            lumaRow(rgb + (size_t)y * stride, gray + (size_t)y * width, width);
+        }
+
+        #pragma omp for schedule(static) nowait
+        for (int y = 1; y < height - 1; y++) {
+            sobelGradientRow(gray + (size_t)(y - 1) * width,
+                             gray + (size_t)y * width,
+                             gray + (size_t)(y + 1) * width,
+                             gx + (size_t)y * gradient_stride,
+                             gy + (size_t)y * gradient_stride,
+                             out ? out + (size_t)y * width : NULL, width);
+        }
+        // Streaming stores are weakly ordered; drain them before the region
+        // ends so the caller sees every plane row.
+        streamFence();
+    }
+
+    memset(gx, 0, (size_t)width * sizeof(int16_t));
+    memset(gy, 0, (size_t)width * sizeof(int16_t));
+    memset(gx + (size_t)(height - 1) * gradient_stride, 0, (size_t)width * sizeof(int16_t));
+    memset(gy + (size_t)(height - 1) * gradient_stride, 0, (size_t)width * sizeof(int16_t));
+    if (out) {
+        memset(out, 0, width);
+        memset(out + (size_t)(height - 1) * width, 0, width);
+    }
+    return 0;
+}
+
+int EdgeDetector::processGray(const uint8_t* gray, size_t stride, int width, int height, uint8_t* out) {
+    if (!gray || !out || width <= 0 || height <= 0 || stride < (size_t)width) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height);
+        return 0;
+    }
+
+    #pragma omp parallel for schedule(static) num_threads(num_threads_)
+    for (int y = 1; y < height - 1; y++) {
+        sobelRow(gray + (size_t)(y - 1) * stride,
+                 gray + (size_t)y * stride,
+                 gray + (size_t)(y + 1) * stride,
+                 out + (size_t)y * width, width);
+    }
+
+    memset(out, 0, width);
+    memset(out + (size_t)(height - 1) * width, 0, width);
+    return 0;
+}
+
+int EdgeDetector::processColor(const uint8_t* rgb, size_t stride, int width, int height,
+                               SobelColorMode mode, uint8_t* out) {
+    if (!rgb || !out || width <= 0 || height <= 0 || stride < (size_t)width * 3 ||
+        (mode != SOBEL_COLOR_MAX_CHANNEL && mode != SOBEL_COLOR_DI_ZENZO)) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height);
+        return 0;
+    }
+    // The three planes share gray_, each starting on an aligned boundary.
+    size_t plane_size = alignUp((size_t)width * height);
+    if (reserveBytes(3 * plane_size) != 0) {
+        return -1;
+    }
+    uint8_t* planes[3] = {gray_, gray_ + plane_size, gray_ + 2 * plane_size};
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            size_t offset = (size_t)y * width;
+            deinterleaveRow(rgb + (size_t)y * stride, planes[0] + offset, planes[1] + offset,
+                            planes[2] + offset, width);
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 1; y < height - 1; y++) {
+            const uint8_t* up[3];
+            const uint8_t* mid[3];
+            const uint8_t* down[3];
+            for (int c = 0; c < 3; c++) {
+                mid[c] = planes[c] + (size_t)y * width + 1;
+                up[c] = mid[c] - width;
+                down[c] = mid[c] + width;
+            }
+            uint8_t* row = out + (size_t)y * width;
+            row[0] = 0;
+            row[width - 1] = 0;
+            if (mode == SOBEL_COLOR_MAX_CHANNEL) {
+                colorSobelMaxPixels(up, mid, down, row + 1, width - 2);
+            } else {
+                colorSobelDiZenzoPixels(up, mid, down, row + 1, width - 2);
+            }
+        }
+    }
+
+    memset(out, 0, width);
+    memset(out + (size_t)(height - 1) * width, 0, width);
+    return 0;
+}
+
+template <typename Pixel>
+int EdgeDetector::processDeep(const Pixel* image, size_t stride, int channels, int width, int height, Pixel* out) {
+    if (!image || !out || width <= 0 || height <= 0 || (channels != 1 && channels != 3) ||
+        stride < (size_t)width * channels) {
+        return -1;
+    }
+    if (width < 3 || height < 3) {
+        memset(out, 0, (size_t)width * height * sizeof(Pixel));
+        return 0;
+    }
+
+    // Gray input is read in place; RGB is converted into gray_ first.
+    const Pixel* gray = image;
+    size_t gray_stride = stride;
+    if (channels == 3) {
+        if (reserveBytes((size_t)width * height * sizeof(Pixel)) != 0) {
+            return -1;
+        }
+        gray = (const Pixel*) gray_;
+        gray_stride = width;
+    }
+    Pixel* converted = (Pixel*) gray_;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        if (channels == 3) {
+            #pragma omp for schedule(static)
+            for (int y = 0; y < height; y++) {
+                lumaRowDeep(image + (size_t)y * stride, converted + (size_t)y * width, width);
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (int y = 1; y < height - 1; y++) {
+            sobelRowT(gray + (size_t)(y - 1) * gray_stride,
+                      gray + (size_t)y * gray_stride,
+                      gray + (size_t)(y + 1) * gray_stride,
+                      out + (size_t)y * width, width);
+        }
+    }
+
+    memset(out, 0, (size_t)width * sizeof(Pixel));
+    memset(out + (size_t)(height - 1) * width, 0, (size_t)width * sizeof(Pixel));
+    return 0;
+}
+
+int EdgeDetector::process(const uint16_t* rgb, size_t stride, int width, int height, uint16_t* out) {
+    return processDeep(rgb, stride, 3, width, height, out);
+}
+
+int EdgeDetector::process(const float* rgb, size_t stride, int width, int height, float* out) {
+    return processDeep(rgb, stride, 3, width, height, out);
+}
+
+int EdgeDetector::processGray(const uint16_t* gray, size_t stride, int width, int height, uint16_t* out) {
+    return processDeep(gray, stride, 1, width, height, out);
+}
+
+int EdgeDetector::processGray(const float* gray, size_t stride, int width, int height, float* out) {
+    return processDeep(gray, stride, 1, width, height, out);
+}
+
+struct sobel_detector {
+    EdgeDetector detector;
+    explicit sobel_detector(int num_threads) : detector(num_threads) {}
+};
+
+extern "C" {
+
+sobel_detector* sobel_detector_create(int num_threads) {
+    return new (std::nothrow) sobel_detector(num_threads);
+}
+
+void sobel_detector_destroy(sobel_detector* detector) {
+    delete detector;
+}
+
+int sobel_detector_reserve(sobel_detector* detector, int width, int height) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.reserve(width, height);
+}
+
+int sobel_detector_set_tuning(sobel_detector* detector, const EdgeTuning* tuning) {
+    if (!detector || !tuning) {
+        return -1;
+    }
+    return detector->detector.setTuning(*tuning);
+}
+
+int sobel_detector_set_luma(sobel_detector* detector, SobelLumaFormula formula) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.setLuma(formula);
+}
+
+int sobel_detector_process(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                           int width, int height, uint8_t* out) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.process(rgb, stride, width, height, out);
+}
+
+int sobel_detector_process_in_place(sobel_detector* detector, uint8_t* rgb, size_t stride,
+                                    int width, int height) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processInPlace(rgb, stride, width, height);
+}
+
+int sobel_detector_process_batch(sobel_detector* detector, const SobelBatchItem* items, int count) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processBatch(items, count);
+}
+
+int sobel_detector_process_region(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int rx, int ry, int rw, int rh, uint8_t* out) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processRegion(rgb, stride, width, height, rx, ry, rw, rh, out);
+}
+
+int sobel_detector_process_binary(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int threshold, uint8_t* bits, size_t bits_stride) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processBinary(rgb, stride, width, height, threshold, bits, bits_stride);
+}
+
+int sobel_detector_process_points(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int threshold,
+                                  const EdgePoint** points, size_t* count) {
+    if (!detector || !points || !count) {
+        return -1;
+    }
+    return detector->detector.processPoints(rgb, stride, width, height, threshold, points, count);
+}
+
+int sobel_detector_process_runs(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                int width, int height, int threshold,
+                                const EdgeRun** runs, size_t* count) {
+    if (!detector || !runs || !count) {
+        return -1;
+    }
+    return detector->detector.processRuns(rgb, stride, width, height, threshold, runs, count);
+}
+
+int sobel_detector_process_histogram(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                     int width, int height, uint8_t* out,
+                                     EdgeHistogram* histogram, int bins) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processHistogram(rgb, stride, width, height, out, histogram, bins);
+}
+
+int sobel_detector_process_indexed(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                   int width, int height, int threshold, int tile_size,
+                                   uint8_t* out, EdgeTileSummary* tiles) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processIndexed(rgb, stride, width, height, threshold, tile_size, out, tiles);
+}
+
+int sobel_detector_process_auto_binary(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                       int width, int height, double percentile,
+                                       uint8_t* bits, size_t bits_stride, int* threshold_out) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processAutoBinary(rgb, stride, width, height, percentile,
+                                                bits, bits_stride, threshold_out);
+}
+
+// Otsu's method: the split that maximizes between-class variance. Returns
+// the largest magnitude of the lower class.
+int sobel_histogram_otsu(const EdgeHistogram* histogram) {
+    uint64_t total = 0;
+    double sum_all = 0.0;
+    for (int b = 0; b < histogram->bin_count; b++) {
+        total += histogram->bins[b];
+        sum_all += (double)b * histogram->bins[b];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t weight_low = 0;
+    double sum_low = 0.0;
+    double best = -1.0;
+    int best_bin = 0;
+    for (int b = 0; b < histogram->bin_count; b++) {
+        weight_low += histogram->bins[b];
+        if (weight_low == 0) {
+            continue;
+        }
+        uint64_t weight_high = total - weight_low;
+        if (weight_high == 0) {
+            break;
+        }
+        sum_low += (double)b * histogram->bins[b];
+        double mean_low = sum_low / weight_low;
+        double mean_high = (sum_all - sum_low) / weight_high;
+        double between = (double)weight_low * (double)weight_high * (mean_low - mean_high) * (mean_low - mean_high);
+        if (between > best) {
+            best = between;
+            best_bin = b;
+        }
+    }
+    return best_bin * histogram->bin_width + histogram->bin_width - 1;
+}
+
+// Largest magnitude of the lowest `percentile` percent of pixels.
+int sobel_histogram_percentile(const EdgeHistogram* histogram, double percentile) {
+    uint64_t total = 0;
+    for (int b = 0; b < histogram->bin_count; b++) {
+        total += histogram->bins[b];
+    }
+    double target = percentile / 100.0 * (double)total;
+    uint64_t cumulative = 0;
+    for (int b = 0; b < histogram->bin_count; b++) {
+        cumulative += histogram->bins[b];
+        if ((double)cumulative >= target) {
+            return b * histogram->bin_width + histogram->bin_width - 1;
+        }
+    }
+    return histogram->bin_count * histogram->bin_width - 1;
+}
+
+int sobel_detector_process_gradients(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                     int width, int height, uint8_t* out,
+                                     int16_t* gx, int16_t* gy, size_t gradient_stride) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processGradients(rgb, stride, width, height, out, gx, gy, gradient_stride);
+}
+
+size_t sobel_gradient_stride(int width) {
+    return alignUp((size_t)(width > 0 ? width : 0) * sizeof(int16_t)) / sizeof(int16_t);
+}
+
+int sobel_detector_process_gray(sobel_detector* detector, const uint8_t* gray, size_t stride,
+                                int width, int height, uint8_t* out) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processGray(gray, stride, width, height, out);
+}
+
+
+int sobel_detector_process_color(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                 int width, int height, SobelColorMode mode, uint8_t* out) {
+    if (!detector) {
+        return -1;
+    }
+    return detector->detector.processColor(rgb, stride, width, height, mode, out);
+}
+
+int sobel_detector_process_u16(sobel_detector* detector, const uint16_t* image, size_t stride,
+                               int channels, int width, int height, uint16_t* out) {
+    if (!detector || (channels != 1 && channels != 3)) {
+        return -1;
+    }
+    return channels == 1 ? detector->detector.processGray(image, stride, width, height, out)
+                         : detector->detector.process(image, stride, width, height, out);
+}
+
+int sobel_detector_process_f32(sobel_detector* detector, const float* image, size_t stride,
+                               int channels, int width, int height, float* out) {
+    if (!detector || (channels != 1 && channels != 3)) {
+        return -1;
+    }
+    return channels == 1 ? detector->detector.processGray(image, stride, width, height, out)
+                         : detector->detector.process(image, stride, width, height, out);
+}
+
+}
@@ -0,0 +1,325 @@
+#ifndef SOBEL_EDGE_DETECTOR_H
+#define SOBEL_EDGE_DETECTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sparse outputs. Records come out in row-major order.
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t magnitude;
+} EdgePoint;
+
+// Run of `length` consecutive edge pixels starting at (x, y).
+typedef struct {
+    uint32_t x;
+    uint32_t y;
+    uint32_t length;
+} EdgeRun;
+
+// Gradient magnitude histogram. With 256 bins each bin is one clamped
+// magnitude (0..255); with 1024 bins the unclamped range 0..2047 is kept
+// at 2 magnitudes per bin.
+#define SOBEL_HISTOGRAM_MAX_BINS 1024
+
+typedef struct {
+    uint64_t bins[SOBEL_HISTOGRAM_MAX_BINS];
+    int bin_count;
+    int bin_width;
+    uint64_t total;
+} EdgeHistogram;
+
+// Per-tile summary written by processIndexed(), for one tile_size x
+// tile_size tile (smaller on the right and bottom edges). Border pixels
+// count as magnitude 0; the mean magnitude is magnitude_sum / tile pixels.
+#define SOBEL_INDEX_MAX_TILE 4096
+typedef struct {
+    uint32_t edge_count;     // pixels with magnitude above the threshold
+    uint32_t magnitude_sum;  // sum of the clamped magnitudes
+    uint8_t max_magnitude;
+} EdgeTileSummary;
+
+// Parallel decomposition used by process(). The defaults reproduce the
+// plain static row split; sobel_tuner.h measures the best values for a
+// host and stores them in a profile.
+typedef enum {
+    SOBEL_SCHEDULE_STATIC,
+    SOBEL_SCHEDULE_DYNAMIC,
+    SOBEL_SCHEDULE_GUIDED
+} SobelSchedule;
+
+typedef struct {
+    int num_threads;         // OpenMP team size, > 0
+    SobelSchedule schedule;  // how rows (or bands) are handed out
+    int chunk;               // chunk size for the schedule; 0 = OpenMP default
+    int band_rows;           // 0: grayscale pass then Sobel pass over the whole
+                             // image; > 0: fused bands of this many rows whose
+                             // grayscale stays in a per-thread cache-sized buffer
+    int streaming_stores;    // nonzero: write output rows (and, without bands, the
+                             // grayscale rows) with non-temporal stores that
+                             // bypass the cache; pays off once the image is
+                             // well beyond the last-level cache
+} EdgeTuning;
+
+// Luma used to convert RGB to grayscale before Sobel.
+typedef enum {
+    SOBEL_LUMA_LEGACY,  // 0.3 R + 0.59 G + 0.11 B, truncated (the benchmark programs' formula)
+    SOBEL_LUMA_BT601,   // 0.299 R + 0.587 G + 0.114 B on the encoded values, rounded
+    SOBEL_LUMA_BT709,   // 0.2126 R + 0.7152 G + 0.0722 B on the encoded values, rounded
+    SOBEL_LUMA_LINEAR   // BT.709 luminance of the linearized sRGB values, re-encoded to sRGB
+} SobelLumaFormula;
+
+// How processColor() combines the per-channel gradients.
+typedef enum {
+    SOBEL_COLOR_MAX_CHANNEL,  // largest per-channel |Gx| + |Gy|
+    SOBEL_COLOR_DI_ZENZO      // structure-tensor magnitude, sqrt(Gx^2 + Gy^2) on gray input
+} SobelColorMode;
+
+// One image of a processBatch() call; the fields mean the same as the
+// arguments of process().
+typedef struct {
+    const uint8_t* rgb;
+    size_t stride;
+    int width;
+    int height;
+    uint8_t* out;
+} SobelBatchItem;
+
+#ifdef __cplusplus
+#include <vector>
+
+struct LinearLumaTables;
+
+// Reusable Sobel engine. One EdgeDetector owns its intermediate buffers and
+// pins an OpenMP team size, so repeated process() calls only pay for the
+// two passes over the image, not for allocation or thread start-up.
+class EdgeDetector {
+public:
+    // num_threads <= 0 uses omp_get_max_threads().
+    explicit EdgeDetector(int num_threads = 0);
+    ~EdgeDetector();
+
+    EdgeDetector(const EdgeDetector&) = delete;
+    EdgeDetector& operator=(const EdgeDetector&) = delete;
+
+    // rgb: interleaved 8-bit RGB rows, stride bytes apart.
+    // out: width * height bytes, tightly packed. Border pixels are set to 0.
+    // Returns 0 on success, -1 on bad arguments or allocation failure.
+    int process(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out);
+
+    // Memory-lean process(): the edge map replaces the input. Grayscale is
+    // written over the front of the RGB buffer, then each thread turns its
+    // block of gray rows into edge rows in place, keeping the gray rows its
+    // stencil still needs in a 3-row ring. On return the first
+    // width * height bytes of rgb hold the packed edge map and the rest is
+    // garbage. Nothing image-sized is allocated, so peak memory is the RGB
+    // buffer plus a few rows per thread (3 B/px instead of 5).
+    int processInPlace(uint8_t* rgb, size_t stride, int width, int height);
+
+    // process() over many small images (thumbnails) in one parallel
+    // region. Each image is a work item, or several bands of rows once it
+    // is large enough to be worth splitting; threads take items
+    // dynamically and convert each band plus its halo in their own cached
+    // scratch, so nothing is allocated or started per image. Output is
+    // identical to calling process() on each item. Returns -1, with
+    // nothing written, if any item is invalid.
+    int processBatch(const SobelBatchItem* items, int count);
+    // Same as process() for input that is already 8-bit grayscale; skips the
+    // luma pass and reads the rows in place.
+    int processGray(const uint8_t* gray, size_t stride, int width, int height, uint8_t* out);
+
+    // Edges of the rectangle (rx, ry, rw, rh) of a width x height RGB image,
+    // written packed to out (rw * rh bytes). Only the rectangle plus a
+    // 1-pixel halo is converted to grayscale, so cost scales with the
+    // rectangle, not the image. Pixels on the image border are 0, exactly
+    // as in process().
+    int processRegion(const uint8_t* rgb, size_t stride, int width, int height,
+                      int rx, int ry, int rw, int rh, uint8_t* out);
+
+    // Thresholded edge mask, 1 bit per pixel (set where the magnitude is
+    // above threshold), packed MSB-first with (width + 7) / 8 bytes per row
+    // at bits_stride. The compare and packing happen inside the Sobel pass,
+    // so no 8-bit edge plane is written.
+    int processBinary(const uint8_t* rgb, size_t stride, int width, int height,
+                      int threshold, uint8_t* bits, size_t bits_stride);
+
+    // Sparse outputs for images with few edges: every pixel whose magnitude
+    // is above threshold as a point, or as per-row runs. Each thread
+    // collects records for its own block of rows, and the blocks are then
+    // copied into place at prefix-sum offsets, so the merge is lock-free and
+    // the output size follows edge density rather than image area. The
+    // returned array is owned by the detector and valid until the next call.
+    int processPoints(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                      const EdgePoint** points, size_t* count);
+    int processRuns(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                    const EdgeRun** runs, size_t* count);
+
+    // process() that also builds a histogram of the interior magnitudes
+    // (bins = 256 or 1024). Each thread counts into its own private bins
+    // while its rows are still in cache; the bins are summed at the end.
+    int processHistogram(const uint8_t* rgb, size_t stride, int width, int height,
+                         uint8_t* out, EdgeHistogram* histogram, int bins);
+
+    // Colour edges: gradients are taken on each of R, G and B separately
+    // and combined per `mode`, so edges between colours of equal luma are
+    // kept. The RGB rows are first split into three planes held by the
+    // detector; the Sobel pass then reads three planes instead of one.
+    int processColor(const uint8_t* rgb, size_t stride, int width, int height,
+                     SobelColorMode mode, uint8_t* out);
+
+    // High bit-depth input. Strides are in pixels (elements), not bytes.
+    // 16-bit magnitudes are clamped to 65535; float magnitudes are not
+    // clamped. The conversion and Sobel kernels are the same templates for
+    // both, with 32-bit (uint16) or float accumulators.
+    int process(const uint16_t* rgb, size_t stride, int width, int height, uint16_t* out);
+    int process(const float* rgb, size_t stride, int width, int height, float* out);
+    int processGray(const uint16_t* gray, size_t stride, int width, int height, uint16_t* out);
+    int processGray(const float* gray, size_t stride, int width, int height, float* out);
+
+    // process() that also summarizes each tile_size x tile_size tile of the
+    // output (1..SOBEL_INDEX_MAX_TILE) into tiles, row-major with
+    // ceil(width / tile_size) per row. Work is handed out in bands of one
+    // tile row; each thread sums the rows it has just filtered, still in
+    // L1, into private per-tile counters and writes them out once per band.
+    // sobel_index.h builds O(1) region queries on top.
+    int processIndexed(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                       int tile_size, uint8_t* out, EdgeTileSummary* tiles);
+    // Binary mask with an automatic threshold: Otsu when percentile < 0,
+    // otherwise the smallest magnitude at or above that percentile (0..100).
+    // The histogram is built in the Sobel pass; the mask is then packed from
+    // the detector's edge scratch. The chosen threshold is returned through
+    // threshold_out if non-NULL. Thresholds are capped at 254 because the
+    // mask compares clamped magnitudes.
+    int processAutoBinary(const uint8_t* rgb, size_t stride, int width, int height, double percentile,
+                          uint8_t* bits, size_t bits_stride, int* threshold_out);
+
+    // Signed Gx and Gy as separate int16 planes (row r of each starts at
+    // gx + r * gradient_stride elements), written by the same pass that
+    // fills out; out may be NULL when only the gradients are wanted. Border
+    // pixels are 0 in all planes. Rows that are 16-byte aligned are written
+    // with non-temporal stores; sobel_gradient_stride() gives a row pitch
+    // that keeps every row 64-byte aligned when the planes are.
+    int processGradients(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out,
+                         int16_t* gx, int16_t* gy, size_t gradient_stride);
+
+    // Selects the luma formula for every later call that converts RGB,
+    // 8-bit or deep. The 8-bit tables are built here, so switching costs
+    // nothing per frame; deep input in linear light evaluates the sRGB
+    // curves per pixel. Returns -1 for an unknown formula or if the tables
+    // cannot be allocated.
+    int setLuma(SobelLumaFormula formula);
+    SobelLumaFormula luma() const { return luma_; }
+
+    // Replaces the thread count and decomposition chosen at construction.
+    // Returns -1 for invalid values.
+    int setTuning(const EdgeTuning& tuning);
+    const EdgeTuning& tuning() const { return tuning_; }
+
+    // Grow the internal buffers up front so the first process() call of
+    // this size does not allocate.
+    int reserve(int width, int height);
+
+    int numThreads() const { return num_threads_; }
+
+private:
+    template <typename Pixel>
+    int processDeep(const Pixel* image, size_t stride, int channels, int width, int height, Pixel* out);
+    int reserveBytes(size_t bytes);
+    void lumaRow(const uint8_t* rgb, uint8_t* gray, int width) const;
+    template <typename Pixel>
+    void lumaRowDeep(const Pixel* rgb, Pixel* gray, int width) const;
+    void processBands(const uint8_t* rgb, size_t stride, int width, int height, uint8_t* out);
+    // Band [y0, y1) of a processBatch() item.
+    struct BatchUnit {
+        int item;
+        int y0;
+        int y1;
+    };
+
+    template <typename Record>
+    int processSparse(const uint8_t* rgb, size_t stride, int width, int height, int threshold,
+                      std::vector<std::vector<Record> >& local, std::vector<Record>& merged);
+
+    int num_threads_;
+    EdgeTuning tuning_;
+    uint8_t* gray_;
+    size_t gray_capacity_;
+    SobelLumaFormula luma_;
+    uint32_t luma_weights_[3];
+    double luma_coefficients_[3];
+    LinearLumaTables* luma_linear_;
+    std::vector<std::vector<uint8_t> > row_scratch_;
+    std::vector<std::vector<EdgePoint> > local_points_;
+    std::vector<std::vector<EdgeRun> > local_runs_;
+    std::vector<std::vector<uint32_t> > local_bins_;
+    std::vector<std::vector<uint16_t> > raw_scratch_;
+    std::vector<uint8_t> edges_scratch_;
+    std::vector<BatchUnit> batch_units_;
+    std::vector<EdgePoint> points_;
+    std::vector<EdgeRun> runs_;
+};
+
+extern "C" {
+#endif
+
+// C ABI over EdgeDetector.
+typedef struct sobel_detector sobel_detector;
+
+sobel_detector* sobel_detector_create(int num_threads);
+void sobel_detector_destroy(sobel_detector* detector);
+int sobel_detector_reserve(sobel_detector* detector, int width, int height);
+int sobel_detector_set_tuning(sobel_detector* detector, const EdgeTuning* tuning);
+int sobel_detector_set_luma(sobel_detector* detector, SobelLumaFormula formula);
+int sobel_detector_process(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                           int width, int height, uint8_t* out);
+int sobel_detector_process_in_place(sobel_detector* detector, uint8_t* rgb, size_t stride,
+                                    int width, int height);
+int sobel_detector_process_batch(sobel_detector* detector, const SobelBatchItem* items, int count);
+int sobel_detector_process_region(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int rx, int ry, int rw, int rh, uint8_t* out);
+int sobel_detector_process_binary(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int threshold, uint8_t* bits, size_t bits_stride);
+int sobel_detector_process_points(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                  int width, int height, int threshold,
+                                  const EdgePoint** points, size_t* count);
+int sobel_detector_process_runs(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                int width, int height, int threshold,
+                                const EdgeRun** runs, size_t* count);
+int sobel_detector_process_histogram(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                     int width, int height, uint8_t* out,
+                                     EdgeHistogram* histogram, int bins);
+int sobel_detector_process_indexed(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                   int width, int height, int threshold, int tile_size,
+                                   uint8_t* out, EdgeTileSummary* tiles);
+int sobel_detector_process_auto_binary(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                       int width, int height, double percentile,
+                                       uint8_t* bits, size_t bits_stride, int* threshold_out);
+int sobel_detector_process_gradients(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                     int width, int height, uint8_t* out,
+                                     int16_t* gx, int16_t* gy, size_t gradient_stride);
+
+// Row pitch in int16 elements for gradient planes of the given width.
+size_t sobel_gradient_stride(int width);
+
+// Thresholds from a histogram, in magnitude units: pixels with magnitude
+// above the returned value are edges.
+int sobel_histogram_otsu(const EdgeHistogram* histogram);
+int sobel_histogram_percentile(const EdgeHistogram* histogram, double percentile);
+
+int sobel_detector_process_gray(sobel_detector* detector, const uint8_t* gray, size_t stride,
+                                int width, int height, uint8_t* out);
+int sobel_detector_process_color(sobel_detector* detector, const uint8_t* rgb, size_t stride,
+                                 int width, int height, SobelColorMode mode, uint8_t* out);
+
+// 16-bit and float input; strides in elements, channels 1 (gray) or 3 (RGB).
+int sobel_detector_process_u16(sobel_detector* detector, const uint16_t* image, size_t stride,
+                               int channels, int width, int height, uint16_t* out);
+int sobel_detector_process_f32(sobel_detector* detector, const float* image, size_t stride,
+                               int channels, int width, int height, float* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOBEL_EDGE_DETECTOR_H
@@ -0,0 +1,133 @@
+// Interactive edge tiles (LazyEdgeTiles in sobel_lazy.h): each requested
+// tile is computed on first access and cached, and its neighbours are
+// prefetched in the background while the viewer looks at it.
+//
+//   g++ -O3 -march=native -fopenmp sobel_explore.cpp sobel_lazy.cpp sobel_pyramid.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_synthetic.cpp -ljpeg -lpthread -o sobel_explore
+//   ./sobel_explore [options] <input.jpg | synthetic:<pattern>:<W>x<H>> <output_dir> [level,tx,ty ...]
+//
+// Tiles are taken from the command line, or else read from stdin as
+// "<level> <tx> <ty>" lines, and written to <output_dir>/<level>_<tx>_<ty>.jpg.
+// Levels follow the Deep Zoom numbering; the finest is printed at start.
+//
+// Options:
+//   --tile-size <n>      tile size in pixels (254)
+//   --cache-mb <n>       tile cache budget (256)
+//   --prefetch <n>       threads for background prefetching; 0 disables it (1)
+//   --think <ms>         pause after each tile, like a viewer panning (0)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sobel_jpeg_io.h"
+#include "sobel_lazy.h"
+
+#define OUTPUT_QUALITY 95
+#define DEFAULT_CACHE_MB 256
+
+static const char* const origin_names[] = {"computed", "cached", "prefetched"};
+
+static int serveTile(LazyEdgeTiles& tiles, const std::string& output_dir, int level, int tx, int ty,
+                     int think_ms) {
+    double start = omp_get_wtime();
+    LazyTile tile;
+    if (tiles.getTile(level, tx, ty, &tile) != 0) {
+        fprintf(stderr, "Error: No tile %d/%d/%d.\n", level, tx, ty);
+        return -1;
+    }
+    double ready = omp_get_wtime();
+    std::string path = output_dir + "/" + std::to_string(level) + "_" + std::to_string(tx) + "_" +
+                       std::to_string(ty) + ".jpg";
+    if (saveGrayJPEGFile(path.c_str(), tile.pixels->data(), tile.region.width, tile.region.height,
+                         OUTPUT_QUALITY) != 0) {
+        return -1;
+    }
+    printf("tile %d/%d/%d %dx%d %-10s %8.3f ms -> %s\n", level, tx, ty, tile.region.width, tile.region.height,
+           origin_names[tile.origin], (ready - start) * 1e3, path.c_str());
+    fflush(stdout);
+    if (think_ms > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(think_ms));
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int tile_size = 0, prefetch = 1, think_ms = 0;
+    double cache_mb = DEFAULT_CACHE_MB;
+    int first_arg = 1;
+    bool ok = true;
+    while (ok && first_arg + 1 < argc && strncmp(argv[first_arg], "--", 2) == 0) {
+        const char* option = argv[first_arg];
+        const char* value = argv[first_arg + 1];
+        if (strcmp(option, "--tile-size") == 0) {
+            tile_size = atoi(value);
+            ok = tile_size > 0;
+        } else if (strcmp(option, "--cache-mb") == 0) {
+            cache_mb = atof(value);
+            ok = cache_mb > 0.0;
+        } else if (strcmp(option, "--prefetch") == 0) {
+            prefetch = atoi(value);
+            ok = prefetch >= 0;
+        } else if (strcmp(option, "--think") == 0) {
+            think_ms = atoi(value);
+            ok = think_ms >= 0;
+        } else {
+            ok = false;
+        }
+        first_arg += 2;
+    }
+    if (!ok || argc < first_arg + 2) {
+        fprintf(stderr, "Usage: %s [--tile-size n] [--cache-mb n] [--prefetch n] [--think ms]\n"
+                        "           <input.jpg | synthetic:<pattern>:<W>x<H>> <output_dir> [level,tx,ty ...]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+    PyramidOptions options = defaultPyramidOptions(PYRAMID_DZI);
+    options.tile_size = tile_size > 0 ? tile_size : options.tile_size;
+    std::string output_dir = argv[first_arg + 1];
+
+    LazyEdgeTiles tiles((size_t)(cache_mb * 1024 * 1024), 0, prefetch);
+    double start = omp_get_wtime();
+    if (tiles.open(argv[first_arg], options) != 0) {
+        return EXIT_FAILURE;
+    }
+    int width, height;
+    tiles.levelSize(tiles.levels() - 1, &width, &height);
+    printf("Opened %dx%d in %f seconds: levels 0-%d, %dx%d tiles at level %d\n", width, height,
+           omp_get_wtime() - start, tiles.levels() - 1, (width + options.tile_size - 1) / options.tile_size,
+           (height + options.tile_size - 1) / options.tile_size, tiles.levels() - 1);
+    fflush(stdout);
+
+    int failures = 0;
+    if (argc > first_arg + 2) {
+        for (int i = first_arg + 2; i < argc; i++) {
+            int level, tx, ty;
+            if (sscanf(argv[i], "%d,%d,%d", &level, &tx, &ty) != 3) {
+                fprintf(stderr, "Error: Expected level,tx,ty, got %s.\n", argv[i]);
+                failures++;
+                continue;
+            }
+            failures += serveTile(tiles, output_dir, level, tx, ty, think_ms) != 0;
+        }
+    } else {
+        int level, tx, ty;
+        while (scanf("%d %d %d", &level, &tx, &ty) == 3) {
+            failures += serveTile(tiles, output_dir, level, tx, ty, think_ms) != 0;
+        }
+    }
+
+    LazyTileStats stats = tiles.stats();
+    printf("Requests: %llu, hits %llu (%llu prefetched), misses %llu\n", (unsigned long long)stats.requests,
+           (unsigned long long)stats.hits, (unsigned long long)stats.prefetch_hits,
+           (unsigned long long)stats.misses);
+    printf("Prefetched: %llu tiles, evicted %llu, cached %zu tiles (%.1f MB)\n",
+           (unsigned long long)stats.prefetched, (unsigned long long)stats.evictions, stats.tiles,
+           stats.bytes / (1024.0 * 1024.0));
+    return failures == 0 ? 0 : EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+#ifndef SOBEL_HASH_H
+#define SOBEL_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fast non-cryptographic multiply-rotate hashing shared by the result cache
+// keys (sobel_cache.cpp) and the per-tile change detection of the sequence
+// detector (sobel_sequence.cpp). Neither needs resistance to crafted input.
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ull
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME3 0x165667B19E3779F9ull
+
+static inline uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Folds one 64-bit word into hash.
+static inline uint64_t hashRound(uint64_t hash, uint64_t word) {
+    return rotl64(hash ^ (word * HASH_PRIME2), 31) * HASH_PRIME1;
+}
+
+// Folds size bytes into hash 8 at a time; a partial last word is zero-padded.
+// Callers that chain several spans fold in the total length themselves.
+static inline uint64_t hashUpdate(uint64_t hash, const uint8_t* data, size_t size) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash = hashRound(hash, word);
+    }
+    if (i < size) {
+        uint64_t tail = 0;
+        memcpy(&tail, data + i, size - i);
+        hash = hashRound(hash, tail);
+    }
+    return hash;
+}
+
+// Avalanches every input bit across the result.
+static inline uint64_t hashFinal(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#endif // SOBEL_HASH_H
@@ -0,0 +1,286 @@
+#include "sobel_image_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <vector>
+
+#ifdef SOBEL_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef SOBEL_HAVE_TIFF
+#include <tiffio.h>
+#endif
+
+void initImageBuffer16(ImageBuffer16* image) {
+    memset(image, 0, sizeof(*image));
+}
+
+void freeImageBuffer16(ImageBuffer16* image) {
+    free(image->data);
+    initImageBuffer16(image);
+}
+
+static int reserveImageBuffer16(ImageBuffer16* image, size_t samples) {
+    if (samples <= image->capacity) {
+        return 0;
+    }
+    uint16_t* data = (uint16_t*) malloc(samples * sizeof(uint16_t));
+    if (!data) {
+        fprintf(stderr, "Error: Unable to allocate %zu samples for image.\n", samples);
+        return -1;
+    }
+    free(image->data);
+    image->data = data;
+    image->capacity = samples;
+    return 0;
+}
+
+// Copies `count` pixels of `source_channels` samples (8 or 16 bits, native
+// order) into `channels` samples per pixel, dropping any extra channel.
+static void widenRow(const uint8_t* source, int source_channels, int source_bits,
+                     uint16_t* dest, int channels, int count) {
+    for (int x = 0; x < count; x++) {
+        for (int c = 0; c < channels; c++) {
+            size_t i = (size_t)x * source_channels + c;
+            if (source_bits == 16) {
+                uint16_t sample;
+                memcpy(&sample, source + 2 * i, sizeof(sample));
+                dest[(size_t)x * channels + c] = sample;
+            } else {
+                dest[(size_t)x * channels + c] = source[i];
+            }
+        }
+    }
+}
+
+static int bitsForMaxval(int maxval) {
+    int bits = 1;
+    while ((1 << bits) - 1 < maxval) {
+        bits++;
+    }
+    return bits;
+}
+
+// Next header integer of a PNM file, skipping whitespace and # comments.
+static int readPNMValue(FILE* file) {
+    int c = fgetc(file);
+    while (c != EOF && (isspace(c) || c == '#')) {
+        if (c == '#') {
+            while (c != EOF && c != '\n') {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+    int value = -1;
+    while (c != EOF && isdigit(c)) {
+        value = (value < 0 ? 0 : value * 10) + (c - '0');
+        c = fgetc(file);
+    }
+    // c is the single whitespace byte that ends the header field.
+    return value;
+}
+
+static int loadPNM(FILE* file, const char* filename, ImageBuffer16* image) {
+    char magic[2];
+    if (fread(magic, 1, 2, file) != 2 || magic[0] != 'P' || (magic[1] != '5' && magic[1] != '6')) {
+        fprintf(stderr, "Error: %s is not a binary PGM/PPM file.\n", filename);
+        return -1;
+    }
+    int channels = magic[1] == '5' ? 1 : 3;
+    int width = readPNMValue(file);
+    int height = readPNMValue(file);
+    int maxval = readPNMValue(file);
+    if (width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535) {
+        fprintf(stderr, "Error: Bad PNM header in %s.\n", filename);
+        return -1;
+    }
+    size_t samples = (size_t)width * height * channels;
+    if (reserveImageBuffer16(image, samples) != 0) {
+        return -1;
+    }
+
+    int bytes = maxval > 255 ? 2 : 1;
+    std::vector<uint8_t> row((size_t)width * channels * bytes);
+    for (int y = 0; y < height; y++) {
+        if (fread(row.data(), 1, row.size(), file) != row.size()) {
+            fprintf(stderr, "Error: %s is truncated.\n", filename);
+            return -1;
+        }
+        uint16_t* dest = image->data + (size_t)y * width * channels;
+        for (size_t i = 0; i < (size_t)width * channels; i++) {
+            // PNM stores 16-bit samples big-endian.
+            dest[i] = bytes == 2 ? (uint16_t)((row[2 * i] << 8) | row[2 * i + 1]) : row[i];
+        }
+    }
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->bits = bitsForMaxval(maxval);
+    return 0;
+}
+
+#ifdef SOBEL_HAVE_PNG
+static int loadPNG(FILE* file, const char* filename, ImageBuffer16* image) {
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png ? png_create_info_struct(png) : NULL;
+    if (!info) {
+        png_destroy_read_struct(&png, NULL, NULL);
+        return -1;
+    }
+    std::vector<uint8_t> row;
+    if (setjmp(png_jmpbuf(png))) {
+        fprintf(stderr, "Error: Unable to decode PNG %s.\n", filename);
+        png_destroy_read_struct(&png, &info, NULL);
+        return -1;
+    }
+
+    png_init_io(png, file);
+    png_read_info(png, info);
+    // Palette and low-depth gray become 8-bit, alpha is dropped, and 16-bit
+    // samples are swapped to host order; 16-bit depth is kept.
+    png_set_expand(png);
+    png_set_strip_alpha(png);
+    png_uint_16 probe = 1;
+    if (*(uint8_t*)&probe == 1) {
+        png_set_swap(png);
+    }
+    png_read_update_info(png, info);
+
+    int width = (int)png_get_image_width(png, info);
+    int height = (int)png_get_image_height(png, info);
+    int bits = png_get_bit_depth(png, info);
+    int channels = png_get_channels(png, info);
+    if ((channels != 1 && channels != 3) || (bits != 8 && bits != 16) ||
+        png_get_interlace_type(png, info) != PNG_INTERLACE_NONE ||
+        reserveImageBuffer16(image, (size_t)width * height * channels) != 0) {
+        fprintf(stderr, "Error: Unsupported PNG layout in %s.\n", filename);
+        png_destroy_read_struct(&png, &info, NULL);
+        return -1;
+    }
+
+    row.resize(png_get_rowbytes(png, info));
+    for (int y = 0; y < height; y++) {
+        png_read_row(png, row.data(), NULL);
+        widenRow(row.data(), channels, bits, image->data + (size_t)y * width * channels, channels, width);
+    }
+    png_destroy_read_struct(&png, &info, NULL);
+
+    image->width = width;
+    image->height = height;
+    image->channels = channels;
+    image->bits = bits;
+    return 0;
+}
+#endif
+
+#ifdef SOBEL_HAVE_TIFF
+static int loadTIFF(const char* filename, ImageBuffer16* image) {
+    TIFF* tiff = TIFFOpen(filename, "r");
+    if (!tiff) {
+        fprintf(stderr, "Error: Unable to open TIFF %s.\n", filename);
+        return -1;
+    }
+    uint32_t width = 0, height = 0;
+    uint16_t bits = 8, samples = 1, planar = PLANARCONFIG_CONTIG;
+    TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
+    TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples);
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planar);
+
+    int channels = samples >= 3 ? 3 : 1;
+    if (width == 0 || height == 0 || (bits != 8 && bits != 16) || samples == 2 ||
+        planar != PLANARCONFIG_CONTIG ||
+        reserveImageBuffer16(image, (size_t)width * height * channels) != 0) {
+        fprintf(stderr, "Error: Unsupported TIFF layout in %s.\n", filename);
+        TIFFClose(tiff);
+        return -1;
+    }
+
+    // libtiff returns 16-bit samples in host order.
+    std::vector<uint8_t> row((size_t)TIFFScanlineSize(tiff));
+    for (uint32_t y = 0; y < height; y++) {
+        if (TIFFReadScanline(tiff, row.data(), y, 0) < 0) {
+            fprintf(stderr, "Error: Unable to decode TIFF %s.\n", filename);
+            TIFFClose(tiff);
+            return -1;
+        }
+        widenRow(row.data(), samples, bits, image->data + (size_t)y * width * channels, channels, (int)width);
+    }
+    TIFFClose(tiff);
+
+    image->width = (int)width;
+    image->height = (int)height;
+    image->channels = channels;
+    image->bits = bits;
+    return 0;
+}
+#endif
+
+int loadImage16File(const char* filename, ImageBuffer16* image) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", filename);
+        return -1;
+    }
+    uint8_t magic[8] = {0};
+    size_t got = fread(magic, 1, sizeof(magic), file);
+    rewind(file);
+
+    int status = -1;
+    if (got >= 2 && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')) {
+        status = loadPNM(file, filename, image);
+    } else if (got == 8 && memcmp(magic, "\x89PNG\r\n\x1a\n", 8) == 0) {
+#ifdef SOBEL_HAVE_PNG
+        status = loadPNG(file, filename, image);
+#else
+        fprintf(stderr, "Error: %s is PNG; rebuild with -DSOBEL_HAVE_PNG -lpng.\n", filename);
+#endif
+    } else if (got >= 4 && (memcmp(magic, "II*\0", 4) == 0 || memcmp(magic, "MM\0*", 4) == 0)) {
+#ifdef SOBEL_HAVE_TIFF
+        fclose(file);
+        return loadTIFF(filename, image);
+#else
+        fprintf(stderr, "Error: %s is TIFF; rebuild with -DSOBEL_HAVE_TIFF -ltiff.\n", filename);
+#endif
+    } else {
+        fprintf(stderr, "Error: Unknown image format in %s.\n", filename);
+    }
+    fclose(file);
+    return status;
+}
+
+int saveGray16PGMFile(const char* filename, const uint16_t* gray, int width, int height, int maxval) {
+    FILE* outfile;
+    if ((outfile = fopen(filename, "wb")) == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", filename);
+        return -1;
+    }
+    int status = fprintf(outfile, "P5\n%d %d\n%d\n", width, height, maxval) > 0 ? 0 : -1;
+    int bytes = maxval > 255 ? 2 : 1;
+    std::vector<uint8_t> row((size_t)width * bytes);
+    for (int y = 0; y < height && status == 0; y++) {
+        const uint16_t* source = gray + (size_t)y * width;
+        for (int x = 0; x < width; x++) {
+            uint16_t sample = source[x] > maxval ? (uint16_t)maxval : source[x];
+            if (bytes == 2) {
+                row[2 * x] = (uint8_t)(sample >> 8);
+                row[2 * x + 1] = (uint8_t)sample;
+            } else {
+                row[x] = (uint8_t)sample;
+            }
+        }
+        if (fwrite(row.data(), 1, row.size(), outfile) != row.size()) {
+            status = -1;
+        }
+    }
+    if (fclose(outfile) != 0 || status != 0) {
+        fprintf(stderr, "Error: Unable to finish writing %s.\n", filename);
+        return -1;
+    }
+    return 0;
+}
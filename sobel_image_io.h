@@ -0,0 +1,31 @@
+#ifndef SOBEL_IMAGE_IO_H
+#define SOBEL_IMAGE_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 16-bit counterpart of ImageBuffer for high bit-depth sources. Samples
+// keep their original values (a 12-bit sensor stays 0..4095); `bits` is the
+// source depth. 8-bit files are widened without scaling.
+typedef struct {
+    uint16_t* data;
+    size_t capacity;  // in samples
+    int width;
+    int height;
+    int channels;     // 1 (gray) or 3 (RGB)
+    int bits;
+} ImageBuffer16;
+
+void initImageBuffer16(ImageBuffer16* image);
+void freeImageBuffer16(ImageBuffer16* image);
+
+// Loads binary PGM/PPM (P5/P6, maxval up to 65535), and PNG or TIFF when
+// built with -DSOBEL_HAVE_PNG -lpng or -DSOBEL_HAVE_TIFF -ltiff. The format
+// is taken from the file's magic bytes. Alpha channels are dropped.
+// Returns 0 on success, -1 on failure (message on stderr).
+int loadImage16File(const char* filename, ImageBuffer16* image);
+
+// Binary 16-bit PGM (P5, big-endian samples) with the given maxval.
+int saveGray16PGMFile(const char* filename, const uint16_t* gray, int width, int height, int maxval);
+
+#endif // SOBEL_IMAGE_IO_H
@@ -0,0 +1,98 @@
+#include "sobel_index.h"
+
+EdgeDensityIndex::EdgeDensityIndex()
+    : width_(0), height_(0), tile_size_(0), tiles_x_(0), tiles_y_(0) {
+}
+
+int EdgeDensityIndex::build(const EdgeTileSummary* tiles, int width, int height, int tile_size) {
+    if (!tiles || width <= 0 || height <= 0 || tile_size <= 0) {
+        return -1;
+    }
+    width_ = width;
+    height_ = height;
+    tile_size_ = tile_size;
+    tiles_x_ = (width + tile_size - 1) / tile_size;
+    tiles_y_ = (height + tile_size - 1) / tile_size;
+    tiles_.assign(tiles, tiles + (size_t)tiles_x_ * tiles_y_);
+
+    const size_t pitch = (size_t)tiles_x_ + 1;
+    count_table_.assign(pitch * (tiles_y_ + 1), 0);
+    sum_table_.assign(pitch * (tiles_y_ + 1), 0);
+    for (int ty = 0; ty < tiles_y_; ty++) {
+        uint64_t row_count = 0, row_sum = 0;
+        for (int tx = 0; tx < tiles_x_; tx++) {
+            row_count += tile(tx, ty).edge_count;
+            row_sum += tile(tx, ty).magnitude_sum;
+            size_t at = (ty + 1) * pitch + tx + 1;
+            count_table_[at] = count_table_[at - pitch] + row_count;
+            sum_table_[at] = sum_table_[at - pitch] + row_sum;
+        }
+    }
+    return 0;
+}
+
+double EdgeDensityIndex::tileMean(int tx, int ty) const {
+    int w = tx * tile_size_ + tile_size_ < width_ ? tile_size_ : width_ - tx * tile_size_;
+    int h = ty * tile_size_ + tile_size_ < height_ ? tile_size_ : height_ - ty * tile_size_;
+    return (double)tile(tx, ty).magnitude_sum / ((double)w * h);
+}
+
+uint64_t EdgeDensityIndex::tileEdgeCount(int tx0, int ty0, int tx1, int ty1) const {
+    tx0 = tx0 < 0 ? 0 : tx0;
+    ty0 = ty0 < 0 ? 0 : ty0;
+    tx1 = tx1 > tiles_x_ ? tiles_x_ : tx1;
+    ty1 = ty1 > tiles_y_ ? tiles_y_ : ty1;
+    if (tx0 >= tx1 || ty0 >= ty1) {
+        return 0;
+    }
+    const size_t pitch = (size_t)tiles_x_ + 1;
+    return count_table_[ty1 * pitch + tx1] - count_table_[ty0 * pitch + tx1] -
+           count_table_[ty1 * pitch + tx0] + count_table_[ty0 * pitch + tx0];
+}
+
+// The table holds the integral at tile corners; inside a tile the density
+// is constant, so the integral is bilinear between them. Tiles on the
+// right and bottom edge are narrower, so fractions use their real size.
+double EdgeDensityIndex::integral(const std::vector<uint64_t>& table, double x, double y) const {
+    int tx = (int)(x / tile_size_), ty = (int)(y / tile_size_);
+    tx = tx < tiles_x_ ? tx : tiles_x_ - 1;
+    ty = ty < tiles_y_ ? ty : tiles_y_ - 1;
+    double tile_width = tx * tile_size_ + tile_size_ < width_ ? tile_size_ : width_ - tx * tile_size_;
+    double tile_height = ty * tile_size_ + tile_size_ < height_ ? tile_size_ : height_ - ty * tile_size_;
+    double fx = (x - (double)tx * tile_size_) / tile_width;
+    double fy = (y - (double)ty * tile_size_) / tile_height;
+    const size_t pitch = (size_t)tiles_x_ + 1;
+    double s00 = (double)table[ty * pitch + tx], s10 = (double)table[ty * pitch + tx + 1];
+    double s01 = (double)table[(ty + 1) * pitch + tx], s11 = (double)table[(ty + 1) * pitch + tx + 1];
+    return s00 + fx * (s10 - s00) + fy * (s01 - s00) + fx * fy * (s11 - s10 - s01 + s00);
+}
+
+double EdgeDensityIndex::query(const std::vector<uint64_t>& table, int x, int y, int w, int h,
+                               double* area) const {
+    int x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+    int x1 = (long long)x + w > width_ ? width_ : x + w;
+    int y1 = (long long)y + h > height_ ? height_ : y + h;
+    if (tiles_.empty() || x0 >= x1 || y0 >= y1) {
+        *area = 0.0;
+        return 0.0;
+    }
+    *area = (double)(x1 - x0) * (y1 - y0);
+    return integral(table, x1, y1) - integral(table, x0, y1) - integral(table, x1, y0) + integral(table, x0, y0);
+}
+
+double EdgeDensityIndex::edgeCount(int x, int y, int w, int h) const {
+    double area;
+    return query(count_table_, x, y, w, h, &area);
+}
+
+double EdgeDensityIndex::edgeDensity(int x, int y, int w, int h) const {
+    double area;
+    double count = query(count_table_, x, y, w, h, &area);
+    return area > 0.0 ? count / area : 0.0;
+}
+
+double EdgeDensityIndex::meanMagnitude(int x, int y, int w, int h) const {
+    double area;
+    double sum = query(sum_table_, x, y, w, h, &area);
+    return area > 0.0 ? sum / area : 0.0;
+}
@@ -0,0 +1,63 @@
+#ifndef SOBEL_INDEX_H
+#define SOBEL_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "sobel_edge_detector.h"
+
+// Region queries over the tile summaries of EdgeDetector::processIndexed,
+// without touching the full-resolution edge map. Summed-area tables of the
+// per-tile edge counts and magnitude sums make any rectangle query four
+// lookups per table, whatever its size.
+//
+// Rectangles whose sides fall on tile boundaries (or the image border) are
+// exact. Tiles that a rectangle only partly covers contribute in
+// proportion to the covered area, as if their edges were spread evenly
+// across the tile.
+class EdgeDensityIndex {
+public:
+    EdgeDensityIndex();
+
+    // Copies the summaries of a width x height image and builds the
+    // tables. Returns -1 for bad arguments.
+    int build(const EdgeTileSummary* tiles, int width, int height, int tile_size);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int tileSize() const { return tile_size_; }
+    int tilesX() const { return tiles_x_; }
+    int tilesY() const { return tiles_y_; }
+    const EdgeTileSummary& tile(int tx, int ty) const { return tiles_[(size_t)ty * tiles_x_ + tx]; }
+    // Mean magnitude of one tile.
+    double tileMean(int tx, int ty) const;
+
+    // Exact edge count of tiles [tx0, tx1) x [ty0, ty1).
+    uint64_t tileEdgeCount(int tx0, int ty0, int tx1, int ty1) const;
+
+    // Queries over the pixel rectangle (x, y, w, h), clipped to the image.
+    // Empty rectangles give 0.
+    double edgeCount(int x, int y, int w, int h) const;
+    double edgeDensity(int x, int y, int w, int h) const;  // edge pixels / pixels
+    double meanMagnitude(int x, int y, int w, int h) const;
+
+private:
+    // Integral of a table's per-pixel density over [0, x) x [0, y).
+    double integral(const std::vector<uint64_t>& table, double x, double y) const;
+    double query(const std::vector<uint64_t>& table, int x, int y, int w, int h, double* area) const;
+
+    int width_;
+    int height_;
+    int tile_size_;
+    int tiles_x_;
+    int tiles_y_;
+    std::vector<EdgeTileSummary> tiles_;
+    // (tiles_x + 1) * (tiles_y + 1) prefix sums with a zero first row and
+    // column.
+    std::vector<uint64_t> count_table_;
+    std::vector<uint64_t> sum_table_;
+};
+
+#endif // SOBEL_INDEX_H
@@ -0,0 +1,213 @@
+// JPEG I/O benchmark for the libjpeg options in sobel_jpeg_io.h. Each
+// decode option and the speed profile are timed on an in-memory JPEG, so
+// storage is excluded. The decoded pixels and the edge map computed from
+// them are compared with a reference by PSNR. The reference is the
+// original pixels for synthetic input, and the default decode otherwise.
+// The edge map is then encoded with each DCT method, with and without
+// optimized Huffman tables, and the table reports time, size and the PSNR
+// of the re-decoded map.
+//
+//   g++ -O3 -march=native -fopenmp sobel_jpeg_bench.cpp sobel_jpeg_io.cpp sobel_edge_detector.cpp sobel_synthetic.cpp -ljpeg -o sobel_jpeg_bench
+//   ./sobel_jpeg_bench <input.jpg | synthetic:<pattern>:<W>x<H>> [repeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include <jpeglib.h>
+
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_synthetic.h"
+
+#define SOURCE_QUALITY 95
+#define OUTPUT_QUALITY 95
+
+static const char* const dct_names[] = {"islow", "ifast", "float"};
+
+// PSNR in dB of a against b over count 8-bit samples; HUGE_VAL if equal.
+static double psnr(const uint8_t* a, const uint8_t* b, size_t count) {
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        double d = (double)a[i] - b[i];
+        sum += d * d;
+    }
+    return sum == 0.0 ? HUGE_VAL : 10.0 * log10(255.0 * 255.0 * count / sum);
+}
+
+static void printPSNR(double value) {
+    if (value == HUGE_VAL) {
+        printf(" %9s", "exact");
+    } else {
+        printf(" %9.2f", value);
+    }
+}
+
+static int readFile(const char* filename, std::vector<uint8_t>* data) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", filename);
+        return -1;
+    }
+    uint8_t buffer[1 << 16];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data->insert(data->end(), buffer, buffer + count);
+    }
+    fclose(file);
+    return 0;
+}
+
+// Synthetic sources are encoded once with libjpeg defaults (4:2:0 chroma).
+// libjpeg's default error handler exits, which is fine for this harness.
+static int encodeRGBMemory(const ImageBuffer& image, std::vector<uint8_t>* data) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char* buffer = NULL;
+    unsigned long length = 0;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &length);
+    cinfo.image_width = image.width;
+    cinfo.image_height = image.height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, SOURCE_QUALITY, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = image.data + (size_t)cinfo.next_scanline * image.width * 3;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    data->assign(buffer, buffer + length);
+    free(buffer);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <input.jpg | synthetic:<pattern>:<W>x<H>> [repeats]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int repeats = argc > 2 ? atoi(argv[2]) : 5;
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    std::vector<uint8_t> jpeg;
+    ImageBuffer original;
+    initImageBuffer(&original);
+    bool synthetic = strncmp(argv[1], "synthetic:", 10) == 0;
+    if (synthetic) {
+        if (loadImageOrSynthetic(argv[1], &original) != 0 || encodeRGBMemory(original, &jpeg) != 0) {
+            return EXIT_FAILURE;
+        }
+    } else if (readFile(argv[1], &jpeg) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    // Reference decode and edge map, with the default options.
+    ImageBuffer reference;
+    initImageBuffer(&reference);
+    setJPEGIOOptions(defaultJPEGIOOptions());
+    if (decodeJPEGMemory(jpeg.data(), jpeg.size(), &reference) != 0) {
+        return EXIT_FAILURE;
+    }
+    const int width = reference.width;
+    const int height = reference.height;
+    const size_t pixels = (size_t)width * height;
+    const double megapixels = pixels / 1e6;
+    const uint8_t* truth = synthetic ? original.data : reference.data;
+    EdgeDetector detector;
+    std::vector<uint8_t> truth_edges(pixels), edges(pixels);
+    detector.process(truth, (size_t)width * 3, width, height, truth_edges.data());
+
+    printf("Image %dx%d, %zu-byte JPEG, best of %d, PSNR against the %s\n", width, height, jpeg.size(),
+           repeats, synthetic ? "original pixels" : "default decode");
+
+    JPEGIOOptions defaults = defaultJPEGIOOptions();
+    struct {
+        const char* name;
+        JPEGIOOptions options;
+    } decoders[] = {
+        {"default", defaults},
+        {"dct=ifast", defaults},
+        {"dct=float", defaults},
+        {"no fancy upsampling", defaults},
+        {"no block smoothing", defaults},
+        {"speed profile", speedJPEGIOOptions()},
+    };
+    decoders[1].options.dct = JPEG_DCT_IFAST;
+    decoders[2].options.dct = JPEG_DCT_FLOAT;
+    decoders[3].options.fancy_upsampling = 0;
+    decoders[4].options.block_smoothing = 0;
+
+    printf("\n%-22s %10s %9s %9s %9s\n", "decode", "ms", "MP/s", "RGB PSNR", "edge PSNR");
+    ImageBuffer decoded;
+    initImageBuffer(&decoded);
+    for (size_t d = 0; d < sizeof(decoders) / sizeof(decoders[0]); d++) {
+        setJPEGIOOptions(decoders[d].options);
+        double best = HUGE_VAL;
+        for (int r = 0; r < repeats; r++) {
+            double start = omp_get_wtime();
+            if (decodeJPEGMemory(jpeg.data(), jpeg.size(), &decoded) != 0) {
+                return EXIT_FAILURE;
+            }
+            double elapsed = omp_get_wtime() - start;
+            best = elapsed < best ? elapsed : best;
+        }
+        detector.process(decoded.data, (size_t)width * 3, width, height, edges.data());
+        printf("%-22s %10.3f %9.1f", decoders[d].name, best * 1e3, megapixels / best);
+        printPSNR(psnr(decoded.data, truth, pixels * 3));
+        printPSNR(psnr(edges.data(), truth_edges.data(), pixels));
+        printf("\n");
+    }
+
+    // Encode the reference edge map and decode the result with the default
+    // options for the PSNR.
+    printf("\n%-22s %10s %9s %12s %9s\n", "encode", "ms", "MP/s", "bytes", "PSNR");
+    for (int dct = JPEG_DCT_ISLOW; dct <= JPEG_DCT_FLOAT; dct++) {
+        for (int optimize = 0; optimize <= 1; optimize++) {
+            JPEGIOOptions options = defaults;
+            options.dct = (JPEGDctMethod)dct;
+            options.optimize_coding = optimize;
+            setJPEGIOOptions(options);
+            uint8_t* output = NULL;
+            size_t size = 0;
+            double best = HUGE_VAL;
+            for (int r = 0; r < repeats; r++) {
+                free(output);
+                output = NULL;
+                double start = omp_get_wtime();
+                if (encodeGrayJPEGMemory(truth_edges.data(), width, height, OUTPUT_QUALITY,
+                                         &output, &size) != 0) {
+                    return EXIT_FAILURE;
+                }
+                double elapsed = omp_get_wtime() - start;
+                best = elapsed < best ? elapsed : best;
+            }
+            // Gray JPEGs decode to RGB here, so compare one channel.
+            setJPEGIOOptions(defaults);
+            decodeJPEGMemory(output, size, &decoded);
+            for (size_t i = 0; i < pixels; i++) {
+                edges[i] = decoded.data[i * 3];
+            }
+            free(output);
+            char name[48];
+            snprintf(name, sizeof(name), "dct=%s%s", dct_names[dct], optimize ? " optimized" : "");
+            printf("%-22s %10.3f %9.1f %12zu", name, best * 1e3, megapixels / best, size);
+            printPSNR(psnr(edges.data(), truth_edges.data(), pixels));
+            printf("\n");
+        }
+    }
+
+    freeImageBuffer(&decoded);
+    freeImageBuffer(&reference);
+    freeImageBuffer(&original);
+    return 0;
+}
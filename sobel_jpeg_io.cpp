@@ -0,0 +1,365 @@
+#include "sobel_jpeg_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+
+#define RGB_CHANNELS 3
+
+// libjpeg's default error_exit calls exit(); route it back to the caller.
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer;
+} JPEGErrorManager;
+
+static void jpegErrorExit(j_common_ptr cinfo) {
+    JPEGErrorManager* err = (JPEGErrorManager*) cinfo->err;
+    (*cinfo->err->output_message)(cinfo);
+    longjmp(err->setjmp_buffer, 1);
+}
+
+static JPEGIOOptions io_options = {JPEG_DCT_ISLOW, 1, 1, 0};
+
+JPEGIOOptions defaultJPEGIOOptions() {
+    JPEGIOOptions options = {JPEG_DCT_ISLOW, 1, 1, 0};
+    return options;
+}
+
+JPEGIOOptions speedJPEGIOOptions() {
+    JPEGIOOptions options = {JPEG_DCT_IFAST, 0, 0, 0};
+    return options;
+}
+
+void setJPEGIOOptions(const JPEGIOOptions& options) {
+    io_options = options;
+}
+
+const JPEGIOOptions& jpegIOOptions() {
+    return io_options;
+}
+
+static J_DCT_METHOD dctMethod(JPEGDctMethod dct) {
+    return dct == JPEG_DCT_IFAST ? JDCT_IFAST : dct == JPEG_DCT_FLOAT ? JDCT_FLOAT : JDCT_ISLOW;
+}
+
+// Call between jpeg_read_header and jpeg_start_decompress.
+static void applyDecodeOptions(struct jpeg_decompress_struct* cinfo) {
+    cinfo->dct_method = dctMethod(io_options.dct);
+    cinfo->do_fancy_upsampling = io_options.fancy_upsampling ? TRUE : FALSE;
+    cinfo->do_block_smoothing = io_options.block_smoothing ? TRUE : FALSE;
+}
+
+void initImageBuffer(ImageBuffer* image) {
+    memset(image, 0, sizeof(*image));
+}
+
+void freeImageBuffer(ImageBuffer* image) {
+    free(image->data);
+    initImageBuffer(image);
+}
+
+int reserveImageBuffer(ImageBuffer* image, size_t bytes) {
+    if (bytes <= image->capacity) {
+        return 0;
+    }
+    uint8_t* data = (uint8_t*) malloc(bytes);
+    if (!data) {
+        fprintf(stderr, "Error: Unable to allocate %zu bytes for image.\n", bytes);
+        return -1;
+    }
+    free(image->data);
+    image->data = data;
+    image->capacity = bytes;
+    return 0;
+}
+
+// Reads header and pixels once a source manager is attached, at
+// 1/scale_denom of full size. The caller owns setjmp and
+// jpeg_destroy_decompress.
+static int decodeRGB(struct jpeg_decompress_struct* cinfo, ImageBuffer* image, int scale_denom) {
+    jpeg_read_header(cinfo, TRUE);
+    cinfo->out_color_space = JCS_RGB;
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = scale_denom;
+    applyDecodeOptions(cinfo);
+    jpeg_start_decompress(cinfo);
+
+    if (cinfo->output_components != RGB_CHANNELS) {
+        fprintf(stderr, "Error: JPEG must be in RGB format.\n");
+        return -1;
+    }
+
+    size_t row_stride = (size_t)cinfo->output_width * RGB_CHANNELS;
+    if (reserveImageBuffer(image, row_stride * cinfo->output_height) != 0) {
+        return -1;
+    }
+
+    // Decode straight into the destination rows; no per-pixel copy.
+    while (cinfo->output_scanline < cinfo->output_height) {
+        JSAMPROW row = image->data + (size_t)cinfo->output_scanline * row_stride;
+        jpeg_read_scanlines(cinfo, &row, 1);
+    }
+
+    image->width = (int)cinfo->output_width;
+    image->height = (int)cinfo->output_height;
+    image->channels = RGB_CHANNELS;
+
+    jpeg_finish_decompress(cinfo);
+    return 0;
+}
+
+int loadJPEGFile(const char* filename, ImageBuffer* image) {
+    return loadJPEGFileScaled(filename, 1, image);
+}
+
+int loadJPEGFileScaled(const char* filename, int scale_denom, ImageBuffer* image) {
+    if (scale_denom != 1 && scale_denom != 2 && scale_denom != 4 && scale_denom != 8) {
+        fprintf(stderr, "Error: Unsupported JPEG scale 1/%d.\n", scale_denom);
+        return -1;
+    }
+    struct jpeg_decompress_struct cinfo;
+    JPEGErrorManager jerr;
+    FILE* infile;
+
+    if ((infile = fopen(filename, "rb")) == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", filename);
+        return -1;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        return -1;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, infile);
+    int status = decodeRGB(&cinfo, image, scale_denom);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(infile);
+    return status;
+}
+
+int loadJPEGRegion(const char* filename, const ImageRegion* region, ImageBuffer* image,
+                   ImageRegion* window, int* full_width, int* full_height) {
+    struct jpeg_decompress_struct cinfo;
+    JPEGErrorManager jerr;
+    FILE* infile;
+
+    if ((infile = fopen(filename, "rb")) == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for reading.\n", filename);
+        return -1;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        return -1;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, infile);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    applyDecodeOptions(&cinfo);
+    jpeg_start_decompress(&cinfo);
+
+    int width = (int)cinfo.output_width;
+    int height = (int)cinfo.output_height;
+    if (cinfo.output_components != RGB_CHANNELS || region->width <= 0 || region->height <= 0 ||
+        region->x < 0 || region->y < 0 ||
+        region->x + region->width > width || region->y + region->height > height) {
+        fprintf(stderr, "Error: region %dx%d+%d+%d is outside the %dx%d RGB image %s.\n",
+                region->width, region->height, region->x, region->y, width, height, filename);
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        return -1;
+    }
+    if (full_width) *full_width = width;
+    if (full_height) *full_height = height;
+
+    // Region plus 1-pixel halo, clipped to the image.
+    int x0 = region->x > 0 ? region->x - 1 : 0;
+    int y0 = region->y > 0 ? region->y - 1 : 0;
+    int x1 = region->x + region->width < width ? region->x + region->width + 1 : width;
+    int y1 = region->y + region->height < height ? region->y + region->height + 1 : height;
+
+    JDIMENSION crop_x = (JDIMENSION)x0;
+    JDIMENSION crop_width = (JDIMENSION)(x1 - x0);
+#ifdef LIBJPEG_TURBO_VERSION
+    // Fancy upsampling replicates chroma at the crop edge, so keep the crop
+    // one chroma sample clear of the window to decode it bit-exactly. The
+    // crop is then widened to iMCU boundaries and output_width follows it.
+    int pad = cinfo.max_h_samp_factor;
+    int crop_x0 = x0 > pad ? x0 - pad : 0;
+    int crop_x1 = x1 + pad < width ? x1 + pad : width;
+    crop_x = (JDIMENSION)crop_x0;
+    crop_width = (JDIMENSION)(crop_x1 - crop_x0);
+    jpeg_crop_scanline(&cinfo, &crop_x, &crop_width);
+#else
+    crop_x = 0;
+    crop_width = cinfo.output_width;
+#endif
+
+    size_t row_stride = (size_t)crop_width * RGB_CHANNELS;
+    if (reserveImageBuffer(image, row_stride * (size_t)(y1 - y0)) != 0) {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(infile);
+        return -1;
+    }
+
+#ifdef LIBJPEG_TURBO_VERSION
+    if (y0 > 0) {
+        jpeg_skip_scanlines(&cinfo, (JDIMENSION)y0);
+    }
+#else
+    while ((int)cinfo.output_scanline < y0) {
+        JSAMPROW row = image->data;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+#endif
+    while ((int)cinfo.output_scanline < y1) {
+        JSAMPROW row = image->data + (size_t)(cinfo.output_scanline - y0) * row_stride;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    image->width = (int)crop_width;
+    image->height = y1 - y0;
+    image->channels = RGB_CHANNELS;
+    window->x = (int)crop_x;
+    window->y = y0;
+    window->width = (int)crop_width;
+    window->height = y1 - y0;
+
+    // Rows below the window are never decoded.
+    jpeg_abort_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(infile);
+    return 0;
+}
+
+int decodeJPEGMemory(const uint8_t* data, size_t size, ImageBuffer* image) {
+    struct jpeg_decompress_struct cinfo;
+    JPEGErrorManager jerr;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, (unsigned long)size);
+    int status = decodeRGB(&cinfo, image, 1);
+    jpeg_destroy_decompress(&cinfo);
+    return status;
+}
+
+// Writes the plane once a destination manager is attached.
+static void encodeGray(struct jpeg_compress_struct* cinfo, const uint8_t* gray,
+                       int width, int height, int quality) {
+    cinfo->image_width = width;
+    cinfo->image_height = height;
+    cinfo->input_components = 1;
+    cinfo->in_color_space = JCS_GRAYSCALE;
+
+    jpeg_set_defaults(cinfo);
+    jpeg_set_quality(cinfo, quality, TRUE);
+    cinfo->dct_method = dctMethod(io_options.dct);
+    cinfo->optimize_coding = io_options.optimize_coding ? TRUE : FALSE;
+    jpeg_start_compress(cinfo, TRUE);
+
+    while (cinfo->next_scanline < cinfo->image_height) {
+        JSAMPROW row = (JSAMPROW)(gray + (size_t)cinfo->next_scanline * width);
+        jpeg_write_scanlines(cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(cinfo);
+}
+
+int saveGrayJPEGFile(const char* filename, const uint8_t* gray, int width, int height, int quality) {
+    struct jpeg_compress_struct cinfo;
+    JPEGErrorManager jerr;
+    FILE* outfile;
+
+    if ((outfile = fopen(filename, "wb")) == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", filename);
+        return -1;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_compress(&cinfo);
+        fclose(outfile);
+        return -1;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, outfile);
+    encodeGray(&cinfo, gray, width, height, quality);
+    jpeg_destroy_compress(&cinfo);
+    if (fclose(outfile) != 0) {
+        fprintf(stderr, "Error: Unable to finish writing %s.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int formatPBMHeader(char* header, size_t size, int width, int height) {
+    return snprintf(header, size, "P4\n%d %d\n", width, height);
+}
+
+int savePBMFile(const char* filename, const uint8_t* bits, size_t bits_stride, int width, int height) {
+    FILE* outfile;
+    if ((outfile = fopen(filename, "wb")) == NULL) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", filename);
+        return -1;
+    }
+    char header[64];
+    int header_length = formatPBMHeader(header, sizeof(header), width, height);
+    size_t row_bytes = ((size_t)width + 7) / 8;
+    int status = fwrite(header, 1, header_length, outfile) == (size_t)header_length ? 0 : -1;
+    for (int y = 0; y < height && status == 0; y++) {
+        if (fwrite(bits + (size_t)y * bits_stride, 1, row_bytes, outfile) != row_bytes) {
+            status = -1;
+        }
+    }
+    if (fclose(outfile) != 0 || status != 0) {
+        fprintf(stderr, "Error: Unable to finish writing %s.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int encodeGrayJPEGMemory(const uint8_t* gray, int width, int height, int quality,
+                         uint8_t** data, size_t* size) {
+    struct jpeg_compress_struct cinfo;
+    JPEGErrorManager jerr;
+    unsigned char* buffer = NULL;
+    unsigned long length = 0;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = jpegErrorExit;
+    if (setjmp(jerr.setjmp_buffer)) {
+        jpeg_destroy_compress(&cinfo);
+        free(buffer);
+        return -1;
+    }
+
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buffer, &length);
+    encodeGray(&cinfo, gray, width, height, quality);
+    jpeg_destroy_compress(&cinfo);
+
+    *data = buffer;
+    *size = length;
+    return 0;
+}
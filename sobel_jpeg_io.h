@@ -0,0 +1,89 @@
+#ifndef SOBEL_JPEG_IO_H
+#define SOBEL_JPEG_IO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Growable pixel buffer. Decoding into one reuses its storage as long as the
+// new image fits, so long-running callers settle at their high-water mark.
+typedef struct {
+    uint8_t* data;
+    size_t capacity;
+    int width;
+    int height;
+    int channels;
+} ImageBuffer;
+
+void initImageBuffer(ImageBuffer* image);
+void freeImageBuffer(ImageBuffer* image);
+int reserveImageBuffer(ImageBuffer* image, size_t bytes);
+
+typedef struct {
+    int x;
+    int y;
+    int width;
+    int height;
+} ImageRegion;
+
+// libjpeg speed/quality settings used by every decode and encode below.
+// The default profile keeps libjpeg's own defaults (accurate integer DCT,
+// fancy upsampling, block smoothing, standard Huffman tables); the speed
+// profile trades a little accuracy for throughput.
+typedef enum {
+    JPEG_DCT_ISLOW,  // accurate integer DCT (libjpeg default)
+    JPEG_DCT_IFAST,  // faster, less accurate integer DCT
+    JPEG_DCT_FLOAT   // floating-point DCT
+} JPEGDctMethod;
+
+typedef struct {
+    JPEGDctMethod dct;     // decode and encode
+    int fancy_upsampling;  // decode: smooth chroma upsampling instead of replication
+    int block_smoothing;   // decode: interblock smoothing of progressive scans
+    int optimize_coding;   // encode: per-image Huffman tables (smaller, slower)
+} JPEGIOOptions;
+
+JPEGIOOptions defaultJPEGIOOptions();
+// IFAST DCT, no fancy upsampling, no block smoothing, no optimized coding.
+JPEGIOOptions speedJPEGIOOptions();
+// Process-wide; set once before decoding or encoding starts. The I/O
+// threads of sobel_async_io.h read it too.
+void setJPEGIOOptions(const JPEGIOOptions& options);
+const JPEGIOOptions& jpegIOOptions();
+
+// Decode a JPEG file to packed 8-bit RGB. Unlike the benchmark programs'
+// loadJPEGImage these report errors instead of exiting.
+// Returns 0 on success, -1 on failure (message on stderr).
+int loadJPEGFile(const char* filename, ImageBuffer* image);
+
+// loadJPEGFile at 1/scale_denom of full size (1, 2, 4 or 8), using
+// libjpeg's DCT scaling: at 1/8 only the DC coefficient of each block is
+// used, so decoding is far cheaper than a full decode plus a resize.
+// Image dimensions round up (ceil(width / scale_denom)).
+int loadJPEGFileScaled(const char* filename, int scale_denom, ImageBuffer* image);
+
+// Decode only the part of a JPEG file needed for edges in `region`: the
+// region plus a 1-pixel halo. Rows above the window are skipped with
+// jpeg_skip_scanlines, decoding stops after its last row, and with
+// libjpeg-turbo only the iMCU columns covering it are decoded
+// (jpeg_crop_scanline). On return image holds the decoded window and
+// `window` its position in the full image; the window may be wider than
+// asked for because crops are iMCU-aligned. Fails if region does not lie
+// inside the image. full_width/full_height receive the image size if non-NULL.
+int loadJPEGRegion(const char* filename, const ImageRegion* region, ImageBuffer* image,
+                   ImageRegion* window, int* full_width, int* full_height);
+
+// Encode a packed 8-bit grayscale plane as JPEG.
+int saveGrayJPEGFile(const char* filename, const uint8_t* gray, int width, int height, int quality);
+
+// Binary PBM (P4) output for 1-bit edge masks, rows packed MSB-first.
+// formatPBMHeader writes the header into `header` and returns its length.
+int formatPBMHeader(char* header, size_t size, int width, int height);
+int savePBMFile(const char* filename, const uint8_t* bits, size_t bits_stride, int width, int height);
+
+// In-memory variants for callers that do their own file I/O.
+// encodeGrayJPEGMemory returns a malloc'd buffer the caller frees.
+int decodeJPEGMemory(const uint8_t* data, size_t size, ImageBuffer* image);
+int encodeGrayJPEGMemory(const uint8_t* gray, int width, int height, int quality,
+                         uint8_t** data, size_t* size);
+
+#endif // SOBEL_JPEG_IO_H
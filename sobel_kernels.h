@@ -0,0 +1,790 @@
+#ifndef SOBEL_KERNELS_H
+#define SOBEL_KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX512BW__
+#include <immintrin.h>
+#endif
+
+// Row kernels shared by the engines. Each works on one row so callers
+// choose the parallel decomposition (whole rows, tiles, windows).
+
+// Luma of one interleaved RGB row, same coefficients as the benchmark programs.
+static inline void grayscaleRow(const uint8_t* rgb, uint8_t* gray, int width) {
+    #pragma omp simd
+    for (int x = 0; x < width; x++) {
+        gray[x] = (uint8_t)((0.3 * rgb[3 * x]) +
+                            (0.59 * rgb[3 * x + 1]) +
+                            (0.11 * rgb[3 * x + 2]));
+    }
+}
+
+// Fixed-point luma for formulas that are linear in the encoded values
+// (BT.601, BT.709): weights are in 1/65536 units and the result is rounded.
+// Plain integer multiply-adds, so it vectorizes without gathers.
+static inline void lumaRowFixed(const uint8_t* rgb, uint8_t* gray, int width, const uint32_t weights[3]) {
+    const uint32_t wr = weights[0], wg = weights[1], wb = weights[2];
+    #pragma omp simd
+    for (int x = 0; x < width; x++) {
+        gray[x] = (uint8_t)((wr * rgb[3 * x] + wg * rgb[3 * x + 1] + wb * rgb[3 * x + 2] + 32768) >> 16);
+    }
+}
+
+static inline double srgbToLinear(double value) {
+    return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+static inline double linearToSrgb(double value) {
+    return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+}
+
+// Size of the table that re-encodes linear luminance to sRGB.
+#define LUMA_ENCODE_BITS 12
+
+// Tables for lumaRowLinear, from buildLinearLumaTables. linear[c * 256 + v]
+// is channel c's weighted, linearized contribution of code value v in
+// 1/65535 units, so one lookup per channel replaces the transfer function
+// and the multiply. low and high split the same values into bytes for the
+// AVX-512 path.
+typedef struct LinearLumaTables {
+    uint32_t linear[3 * 256];
+    uint8_t encode[1 << LUMA_ENCODE_BITS];
+    uint8_t low[3][256];
+    uint8_t high[3][256];
+} LinearLumaTables;
+
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+// Luminance (in 1/65535 units) where the sRGB encode leaves its linear
+// segment.
+#define LUMA_ENCODE_KNEE 205.18f
+
+// The sRGB encode above the knee as a degree-4 polynomial in the fourth
+// root of luminance (in 1/65535 units), giving code values. Minimax fit;
+// within 0.01 codes of linearToSrgb.
+static const float LUMA_ENCODE_POLY[5] = {
+    0.000316271792f, -0.0208796673f, 1.1182005f, 3.12651045f, -16.4770541f
+};
+
+// 256-entry byte table held in four registers, looked up for 64 indices:
+// two 128-entry permutes, picked by the top bit of the index.
+static inline __m512i lookupBytes512(const uint8_t* table, __m512i index) {
+    __m512i low = _mm512_permutex2var_epi8(_mm512_loadu_si512(table), index,
+                                           _mm512_loadu_si512(table + 64));
+    __m512i high = _mm512_permutex2var_epi8(_mm512_loadu_si512(table + 128), index,
+                                            _mm512_loadu_si512(table + 192));
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(index), low, high);
+}
+
+// sRGB codes of 16 luminances in 1/65535 units, the fourth root taken as
+// two rsqrt14 steps. Replaces the encode table, which would need a gather.
+static inline __m512i lumaEncode512(__m512i luminance) {
+    __m512 value = _mm512_cvtepi32_ps(luminance);
+    __m512 root = _mm512_rsqrt14_ps(_mm512_rsqrt14_ps(value));
+    __m512 encoded = _mm512_set1_ps(LUMA_ENCODE_POLY[0]);
+    for (int i = 1; i < 5; i++) {
+        encoded = _mm512_fmadd_ps(encoded, root, _mm512_set1_ps(LUMA_ENCODE_POLY[i]));
+    }
+    __mmask16 dark = _mm512_cmp_ps_mask(value, _mm512_set1_ps(LUMA_ENCODE_KNEE), _CMP_LE_OQ);
+    encoded = _mm512_mask_mul_ps(encoded, dark, value, _mm512_set1_ps(12.92f * 255.0f / 65535.0f));
+    return _mm512_cvtps_epi32(encoded);
+}
+
+// 64 pixels per step: the channels are split out with byte permutes, each
+// table lookup stays in registers, and the 16-bit luminance is encoded in
+// four float batches. The unpacks and packs interleave the same way, so
+// pixel order survives. Returns the number of pixels done.
+static inline int lumaRowLinear512(const uint8_t* rgb, uint8_t* gray, int width, const LinearLumaTables* tables) {
+    const __m512i lane = _mm512_set_epi32(0x3f3e3d3c, 0x3b3a3938, 0x37363534, 0x33323130,
+                                          0x2f2e2d2c, 0x2b2a2928, 0x27262524, 0x23222120,
+                                          0x1f1e1d1c, 0x1b1a1918, 0x17161514, 0x13121110,
+                                          0x0f0e0d0c, 0x0b0a0908, 0x07060504, 0x03020100);
+    const __m512i sixty_four = _mm512_set1_epi8(64);
+    __m512i offsets[3];
+    __mmask64 upper[3];
+    for (int c = 0; c < 3; c++) {
+        offsets[c] = _mm512_add_epi8(_mm512_add_epi8(lane, lane), _mm512_add_epi8(lane, _mm512_set1_epi8((char)c)));
+        upper[c] = _mm512_cmpge_epu8_mask(offsets[c], _mm512_set1_epi8((char)128));
+    }
+    const __m512i zero = _mm512_setzero_si512();
+    int x = 0;
+    for (; x + 64 <= width; x += 64) {
+        const uint8_t* src = rgb + 3 * x;
+        __m512i first = _mm512_loadu_si512(src);
+        __m512i second = _mm512_loadu_si512(src + 64);
+        __m512i third = _mm512_loadu_si512(src + 128);
+        __m512i low_sum = zero, high_sum = zero;
+        for (int c = 0; c < 3; c++) {
+            __m512i value = _mm512_mask_blend_epi8(upper[c],
+                _mm512_permutex2var_epi8(first, offsets[c], second),
+                _mm512_permutex2var_epi8(second, _mm512_sub_epi8(offsets[c], sixty_four), third));
+            __m512i low = lookupBytes512(tables->low[c], value);
+            __m512i high = lookupBytes512(tables->high[c], value);
+            // Saturating, as in the clamp of the scalar loop.
+            low_sum = _mm512_adds_epu16(low_sum, _mm512_unpacklo_epi8(low, high));
+            high_sum = _mm512_adds_epu16(high_sum, _mm512_unpackhi_epi8(low, high));
+        }
+        __m512i low_words = _mm512_packus_epi32(lumaEncode512(_mm512_unpacklo_epi16(low_sum, zero)),
+                                                lumaEncode512(_mm512_unpackhi_epi16(low_sum, zero)));
+        __m512i high_words = _mm512_packus_epi32(lumaEncode512(_mm512_unpacklo_epi16(high_sum, zero)),
+                                                 lumaEncode512(_mm512_unpackhi_epi16(high_sum, zero)));
+        _mm512_storeu_si512(gray + x, _mm512_packus_epi16(low_words, high_words));
+    }
+    return x;
+}
+#endif
+
+// Luma computed in linear light: the summed linear luminance is mapped
+// back to an 8-bit sRGB code through the 4096-entry encode table. With
+// AVX-512 VBMI, whole blocks of 64 pixels go through lumaRowLinear512
+// instead, which keeps the lookups in registers and evaluates the encode,
+// so the two can differ by one code.
+static inline void lumaRowLinear(const uint8_t* rgb, uint8_t* gray, int width, const LinearLumaTables* tables) {
+    const uint32_t* red = tables->linear;
+    const uint32_t* green = tables->linear + 256;
+    const uint32_t* blue = tables->linear + 512;
+    int x = 0;
+#if defined(__AVX512BW__) && defined(__AVX512VBMI__)
+    x = lumaRowLinear512(rgb, gray, width, tables);
+#endif
+    for (; x < width; x++) {
+        uint32_t luminance = red[rgb[3 * x]] + green[rgb[3 * x + 1]] + blue[rgb[3 * x + 2]];
+        // Rounded contributions can sum to 65536 for white.
+        luminance = luminance > 65535 ? 65535 : luminance;
+        gray[x] = tables->encode[luminance >> (16 - LUMA_ENCODE_BITS)];
+    }
+}
+
+// Tables for lumaRowLinear with the given luminance coefficients (which
+// sum to 1).
+static inline void buildLinearLumaTables(const double coefficients[3], LinearLumaTables* tables) {
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 256; v++) {
+            uint32_t contribution = (uint32_t)(coefficients[c] * srgbToLinear(v / 255.0) * 65535.0 + 0.5);
+            tables->linear[c * 256 + v] = contribution;
+            tables->low[c][v] = (uint8_t)contribution;
+            tables->high[c][v] = (uint8_t)(contribution >> 8);
+        }
+    }
+    const int entries = 1 << LUMA_ENCODE_BITS;
+    for (int i = 0; i < entries; i++) {
+        double luminance = (i + 0.5) / entries;
+        tables->encode[i] = (uint8_t)(linearToSrgb(luminance) * 255.0 + 0.5);
+    }
+}
+
+// |Gx| + |Gy| clamped to 255 for `count` consecutive pixels. up, mid and
+// down point at the centre pixel of the first stencil and must be readable
+// one pixel to either side. The 3x3 kernels are expanded by hand so the
+// loop has no inner trip counts and vectorizes.
+static inline void sobelPixels(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                               uint8_t* out, int count) {
+    #pragma omp simd
+    for (int x = 0; x < count; x++) {
+        int gradient_x = (up[x + 1] - up[x - 1]) +
+                         2 * (mid[x + 1] - mid[x - 1]) +
+                         (down[x + 1] - down[x - 1]);
+        int gradient_y = (down[x - 1] + 2 * down[x] + down[x + 1]) -
+                         (up[x - 1] + 2 * up[x] + up[x + 1]);
+        int gradient = abs(gradient_x) + abs(gradient_y);
+        out[x] = (uint8_t)(gradient > 255 ? 255 : gradient);
+    }
+}
+
+// Columns [x0, x1) of one row, indexed the same in input and output. The
+// caller guarantees x0 >= 1 and x1 <= width - 1.
+static inline void sobelSpan(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                             uint8_t* out, int x0, int x1) {
+    sobelPixels(up + x0, mid + x0, down + x0, out + x0, x1 - x0);
+}
+
+// One full output row; the first and last column are border and set to 0.
+static inline void sobelRow(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                            uint8_t* out, int width) {
+    out[0] = 0;
+    sobelSpan(up, mid, down, out, 1, width - 1);
+    out[width - 1] = 0;
+}
+
+// sobelPixels that also tallies each magnitude into per-column counters
+// indexed like out: the count above threshold, the sum and the maximum.
+// Tallying from the magnitudes still in registers saves a second pass
+// over the row. The arithmetic is kept in 16 bits, which |Gx| + |Gy| fits,
+// so the loop vectorizes at the width of the 16-bit tallies instead of
+// widening to 32-bit lanes.
+static inline void sobelPixelsTally(const uint8_t* up, const uint8_t* mid, const uint8_t* down, uint8_t* out,
+                                    int count, uint8_t threshold, uint16_t* counts, uint16_t* sums, uint8_t* maxima) {
+    #pragma omp simd
+    for (int x = 0; x < count; x++) {
+        int16_t gradient_x = (int16_t)((up[x + 1] - up[x - 1]) +
+                                       2 * (mid[x + 1] - mid[x - 1]) +
+                                       (down[x + 1] - down[x - 1]));
+        int16_t gradient_y = (int16_t)((down[x - 1] + 2 * down[x] + down[x + 1]) -
+                                       (up[x - 1] + 2 * up[x] + up[x + 1]));
+        uint16_t gradient = (uint16_t)((gradient_x < 0 ? -gradient_x : gradient_x) +
+                                       (gradient_y < 0 ? -gradient_y : gradient_y));
+        uint8_t magnitude = (uint8_t)(gradient > 255 ? 255 : gradient);
+        out[x] = magnitude;
+        counts[x] += magnitude > threshold;
+        sums[x] += magnitude;
+        maxima[x] = magnitude > maxima[x] ? magnitude : maxima[x];
+    }
+}
+
+#ifdef __AVX512BW__
+// Horizontal smoothing (left + 2 centre + right) and difference (right -
+// left) of 32 gray pixels, the two row terms the 3x3 Sobel kernels factor
+// into.
+static inline void sobelRowTerms512(const uint8_t* row, __m512i* smooth, __m512i* difference) {
+    __m512i left = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(row - 1)));
+    __m512i centre = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)row));
+    __m512i right = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(row + 1)));
+    *smooth = _mm512_add_epi16(_mm512_add_epi16(left, right), _mm512_slli_epi16(centre, 1));
+    *difference = _mm512_sub_epi16(right, left);
+}
+
+// sobelPixelsTally for 64 columns down `rows` rows. Walking down the
+// columns, each gray row is loaded and split into its smoothing and
+// difference terms once and reused by the three output rows it touches,
+// and the tallies stay in registers until the end. up points at the
+// centre pixel of the first stencil, out at the matching output pixel.
+static inline void sobelColumnsTally512(const uint8_t* up, int width, uint8_t* out, int rows, uint8_t threshold,
+                                        uint16_t* counts, uint16_t* sums, uint8_t* maxima) {
+    const __m512i limit = _mm512_set1_epi16(threshold);
+    const __m512i clamp = _mm512_set1_epi16(255);
+    const __m512i one = _mm512_set1_epi16(1);
+    __m512i count[2], sum[2], peak[2];
+    __m512i smooth[2][3], difference[2][3];
+    for (int h = 0; h < 2; h++) {
+        count[h] = _mm512_loadu_si512(counts + 32 * h);
+        sum[h] = _mm512_loadu_si512(sums + 32 * h);
+        peak[h] = _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*)(maxima + 32 * h)));
+        sobelRowTerms512(up + 32 * h, &smooth[h][0], &difference[h][0]);
+        sobelRowTerms512(up + width + 32 * h, &smooth[h][1], &difference[h][1]);
+    }
+    for (int r = 0; r < rows; r++) {
+        const uint8_t* down = up + (size_t)(r + 2) * width;
+        // The walk touches more rows at once than the hardware prefetcher
+        // follows, so fetch the incoming row a couple of strips ahead.
+        _mm_prefetch((const char*)(down + 128), _MM_HINT_T0);
+        for (int h = 0; h < 2; h++) {
+            sobelRowTerms512(down + 32 * h, &smooth[h][2], &difference[h][2]);
+            __m512i gx = _mm512_add_epi16(_mm512_add_epi16(difference[h][0], difference[h][2]),
+                                          _mm512_slli_epi16(difference[h][1], 1));
+            __m512i gy = _mm512_sub_epi16(smooth[h][2], smooth[h][0]);
+            __m512i magnitude = _mm512_min_epu16(_mm512_add_epi16(_mm512_abs_epi16(gx), _mm512_abs_epi16(gy)), clamp);
+            _mm256_storeu_si256((__m256i*)(out + (size_t)r * width + 32 * h), _mm512_cvtepi16_epi8(magnitude));
+            count[h] = _mm512_mask_add_epi16(count[h], _mm512_cmpgt_epu16_mask(magnitude, limit), count[h], one);
+            sum[h] = _mm512_add_epi16(sum[h], magnitude);
+            peak[h] = _mm512_max_epu16(peak[h], magnitude);
+            smooth[h][0] = smooth[h][1];
+            smooth[h][1] = smooth[h][2];
+            difference[h][0] = difference[h][1];
+            difference[h][1] = difference[h][2];
+        }
+    }
+    for (int h = 0; h < 2; h++) {
+        _mm512_storeu_si512(counts + 32 * h, count[h]);
+        _mm512_storeu_si512(sums + 32 * h, sum[h]);
+        _mm256_storeu_si256((__m256i*)(maxima + 32 * h), _mm512_cvtepi16_epi8(peak[h]));
+    }
+}
+#endif
+
+// Sobel rows of a packed gray plane with the tallies of sobelPixelsTally.
+// gray points at the row above the first output row, out at that output
+// row; the zero border columns add nothing to the tallies. With AVX-512BW
+// the rows are walked 64 columns at a time, so the tallies and the row
+// terms stay in registers. A walk covers at most TALLY_WALK_ROWS rows: each
+// row is its own page, and taller walks overflow the first-level TLB.
+#define TALLY_WALK_ROWS 16
+
+static inline void sobelRowsTally(const uint8_t* gray, uint8_t* out, int width, int rows, uint8_t threshold,
+                                  uint16_t* counts, uint16_t* sums, uint8_t* maxima) {
+    for (int r = 0; r < rows; r++) {
+        out[(size_t)r * width] = 0;
+        out[(size_t)r * width + width - 1] = 0;
+    }
+    int x = 1;
+#ifdef __AVX512BW__
+    for (int r0 = 0; r0 < rows; r0 += TALLY_WALK_ROWS) {
+        int walk = rows - r0 < TALLY_WALK_ROWS ? rows - r0 : TALLY_WALK_ROWS;
+        for (x = 1; x + 64 <= width - 1; x += 64) {
+            sobelColumnsTally512(gray + (size_t)r0 * width + x, width, out + (size_t)r0 * width + x, walk, threshold,
+                                 counts + x, sums + x, maxima + x);
+        }
+    }
+#endif
+    for (int r = 0; r < rows; r++) {
+        const uint8_t* up = gray + (size_t)r * width;
+        sobelPixelsTally(up + x, up + width + x, up + 2 * width + x, out + (size_t)r * width + x, width - 1 - x,
+                         threshold, counts + x, sums + x, maxima + x);
+    }
+}
+
+// Unclamped |Gx| + |Gy| (0..2040) for `count` pixels, same layout as
+// sobelPixels. Used where the magnitude range above 255 matters.
+static inline void sobelPixelsRaw(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                  uint16_t* out, int count) {
+    #pragma omp simd
+    for (int x = 0; x < count; x++) {
+        int gradient_x = (up[x + 1] - up[x - 1]) +
+                         2 * (mid[x + 1] - mid[x - 1]) +
+                         (down[x + 1] - down[x - 1]);
+        int gradient_y = (down[x - 1] + 2 * down[x] + down[x + 1]) -
+                         (up[x - 1] + 2 * up[x] + up[x + 1]);
+        out[x] = (uint16_t)(abs(gradient_x) + abs(gradient_y));
+    }
+}
+
+// Clamped |Gx| + |Gy| of a single pixel; scalar companion of sobelPixels.
+static inline int sobelMagnitude(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int x) {
+    int gradient_x = (up[x + 1] - up[x - 1]) + 2 * (mid[x + 1] - mid[x - 1]) + (down[x + 1] - down[x - 1]);
+    int gradient_y = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+    int gradient = abs(gradient_x) + abs(gradient_y);
+    return gradient > 255 ? 255 : gradient;
+}
+
+static inline uint8_t reverseBits(uint8_t b) {
+    b = (uint8_t)(((b & 0xF0) >> 4) | ((b & 0x0F) << 4));
+    b = (uint8_t)(((b & 0xCC) >> 2) | ((b & 0x33) << 2));
+    b = (uint8_t)(((b & 0xAA) >> 1) | ((b & 0x55) << 1));
+    return b;
+}
+
+#ifdef __SSE2__
+static inline __m128i absEpi16(__m128i v) {
+    return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// |Gx| + |Gy| for 8 pixels in 16-bit lanes (at most 2040, no overflow).
+static inline __m128i sobelMagnitude8(__m128i ul, __m128i uc, __m128i ur,
+                                      __m128i ml, __m128i mr,
+                                      __m128i dl, __m128i dc, __m128i dr) {
+    __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(ur, ul), _mm_sub_epi16(dr, dl)),
+                               _mm_slli_epi16(_mm_sub_epi16(mr, ml), 1));
+    __m128i gy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(dl, dr), _mm_slli_epi16(dc, 1)),
+                               _mm_add_epi16(_mm_add_epi16(ul, ur), _mm_slli_epi16(uc, 1)));
+    return _mm_add_epi16(absEpi16(gx), absEpi16(gy));
+}
+#endif
+
+// Gx, Gy and the clamped magnitude (if mag is non-NULL) of a single pixel.
+static inline void sobelGradientPixel(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                      int16_t* gx, int16_t* gy, uint8_t* mag, int x) {
+    int gradient_x = (up[x + 1] - up[x - 1]) + 2 * (mid[x + 1] - mid[x - 1]) + (down[x + 1] - down[x - 1]);
+    int gradient_y = (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+    gx[x] = (int16_t)gradient_x;
+    gy[x] = (int16_t)gradient_y;
+    if (mag) {
+        int gradient = abs(gradient_x) + abs(gradient_y);
+        mag[x] = (uint8_t)(gradient > 255 ? 255 : gradient);
+    }
+}
+
+// Signed Gx and Gy planes plus the clamped magnitude for one full row; the
+// first and last column are border and set to 0. mag may be NULL. With
+// SSE2, gx and gy are written with non-temporal stores in 8-pixel blocks
+// whenever both rows are 16-byte aligned, so the planes stream to memory
+// without evicting the grayscale rows still needed by the next rows. The
+// caller issues _mm_sfence() before the planes are read by another thread.
+static inline void sobelGradientRow(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                    int16_t* gx, int16_t* gy, uint8_t* mag, int width) {
+    // Pixels [1, 8) are scalar so the vector blocks start at x = 8.
+    int head_end = width - 1 < 8 ? width - 1 : 8;
+    int x = head_end;
+#ifdef __SSE2__
+    if ((((uintptr_t)gx | (uintptr_t)gy) & 15) == 0) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; x + 9 <= width; x += 8) {
+            __m128i ul = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(up + x - 1)), zero);
+            __m128i uc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(up + x)), zero);
+            __m128i ur = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(up + x + 1)), zero);
+            __m128i ml = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(mid + x - 1)), zero);
+            __m128i mr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(mid + x + 1)), zero);
+            __m128i dl = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(down + x - 1)), zero);
+            __m128i dc = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(down + x)), zero);
+            __m128i dr = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(down + x + 1)), zero);
+            __m128i vx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(ur, ul), _mm_sub_epi16(dr, dl)),
+                                       _mm_slli_epi16(_mm_sub_epi16(mr, ml), 1));
+            __m128i vy = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(dl, dr), _mm_slli_epi16(dc, 1)),
+                                       _mm_add_epi16(_mm_add_epi16(ul, ur), _mm_slli_epi16(uc, 1)));
+            _mm_stream_si128((__m128i*)(gx + x), vx);
+            _mm_stream_si128((__m128i*)(gy + x), vy);
+            if (mag) {
+                __m128i sum = _mm_add_epi16(absEpi16(vx), absEpi16(vy));
+                _mm_storel_epi64((__m128i*)(mag + x), _mm_packus_epi16(sum, zero));
+            }
+        }
+    }
+#endif
+    gx[0] = 0;
+    gy[0] = 0;
+    gx[width - 1] = 0;
+    gy[width - 1] = 0;
+    if (mag) {
+        mag[0] = 0;
+        mag[width - 1] = 0;
+    }
+    for (int i = 1; i < head_end; i++) {
+        sobelGradientPixel(up, mid, down, gx, gy, mag, i);
+    }
+    for (; x < width - 1; x++) {
+        sobelGradientPixel(up, mid, down, gx, gy, mag, x);
+    }
+}
+
+// Sobel with the threshold fused in: one output bit per pixel, set when the
+// clamped magnitude is above `threshold`. Bits are packed MSB-first into
+// (width + 7) / 8 bytes, the PBM (P4) row layout; border pixels are 0.
+// With SSE2 each step filters 16 pixels in 16-bit lanes, compares against
+// the threshold and collapses the result with movemask.
+static inline void sobelBinaryRow(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                  uint8_t* bits, int width, int threshold) {
+    memset(bits, 0, (size_t)(width + 7) / 8);
+    if (width < 3) {
+        return;
+    }
+    // Pixels [1, 16) are done scalar so the vector loop never reads x - 1 < 0.
+    int head_end = width - 1 < 16 ? width - 1 : 16;
+    int x = head_end;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i limit = _mm_set1_epi16((short)threshold);
+    const __m128i clamp = _mm_set1_epi16(255);
+    for (; x + 17 <= width; x += 16) {
+        __m128i vu[3], vm[3], vd[3];
+        for (int k = 0; k < 3; k++) {
+            vu[k] = _mm_loadu_si128((const __m128i*)(up + x - 1 + k));
+            vm[k] = _mm_loadu_si128((const __m128i*)(mid + x - 1 + k));
+            vd[k] = _mm_loadu_si128((const __m128i*)(down + x - 1 + k));
+        }
+        __m128i lo = sobelMagnitude8(_mm_unpacklo_epi8(vu[0], zero), _mm_unpacklo_epi8(vu[1], zero),
+                                     _mm_unpacklo_epi8(vu[2], zero), _mm_unpacklo_epi8(vm[0], zero),
+                                     _mm_unpacklo_epi8(vm[2], zero), _mm_unpacklo_epi8(vd[0], zero),
+                                     _mm_unpacklo_epi8(vd[1], zero), _mm_unpacklo_epi8(vd[2], zero));
+        __m128i hi = sobelMagnitude8(_mm_unpackhi_epi8(vu[0], zero), _mm_unpackhi_epi8(vu[1], zero),
+                                     _mm_unpackhi_epi8(vu[2], zero), _mm_unpackhi_epi8(vm[0], zero),
+                                     _mm_unpackhi_epi8(vm[2], zero), _mm_unpackhi_epi8(vd[0], zero),
+                                     _mm_unpackhi_epi8(vd[1], zero), _mm_unpackhi_epi8(vd[2], zero));
+        lo = _mm_min_epi16(lo, clamp);
+        hi = _mm_min_epi16(hi, clamp);
+        __m128i above = _mm_packs_epi16(_mm_cmpgt_epi16(lo, limit), _mm_cmpgt_epi16(hi, limit));
+        int mask = _mm_movemask_epi8(above);
+        bits[x / 8] = reverseBits((uint8_t)mask);
+        bits[x / 8 + 1] = reverseBits((uint8_t)(mask >> 8));
+    }
+#endif
+    for (int i = 1; i < head_end; i++) {
+        if (sobelMagnitude(up, mid, down, i) > threshold) {
+            bits[i / 8] |= (uint8_t)(0x80 >> (i % 8));
+        }
+    }
+    for (; x < width - 1; x++) {
+        if (sobelMagnitude(up, mid, down, x) > threshold) {
+            bits[x / 8] |= (uint8_t)(0x80 >> (x % 8));
+        }
+    }
+}
+
+// Write-once output rows with non-temporal stores. Rows written this way go
+// straight to memory instead of evicting the input rows the stencil still
+// needs. Streaming stores are weakly ordered: every thread must call
+// streamFence() after its last one, before anyone else reads the rows.
+#define STREAM_CHUNK 256
+
+static inline void streamFence() {
+#ifdef __SSE2__
+    _mm_sfence();
+#endif
+}
+
+// Copies count bytes from an L1-resident chunk to dst with streaming
+// stores; dst must be 16-byte aligned.
+static inline void streamChunk(uint8_t* dst, const uint8_t* chunk, int count) {
+#ifdef __SSE2__
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm_stream_si128((__m128i*)(dst + i), _mm_load_si128((const __m128i*)(chunk + i)));
+    }
+    memcpy(dst + i, chunk + i, count - i);
+#else
+    memcpy(dst, chunk, count);
+#endif
+}
+
+// sobelRow with streaming stores. The pixels are computed by the same
+// sobelPixels loop into a chunk that stays in L1, so the arithmetic is
+// vectorized exactly as in sobelRow, and then copied out in aligned
+// 16-byte blocks.
+static inline void sobelRowStream(const uint8_t* up, const uint8_t* mid, const uint8_t* down,
+                                  uint8_t* out, int width) {
+    out[0] = 0;
+    out[width - 1] = 0;
+    // First x >= 1 with out + x on a 16-byte boundary.
+    int x = 1 + (int)((16 - ((uintptr_t)(out + 1) & 15)) & 15);
+    if (x > width - 1) {
+        x = width - 1;
+    }
+    sobelPixels(up + 1, mid + 1, down + 1, out + 1, x - 1);
+    alignas(16) uint8_t chunk[STREAM_CHUNK];
+    for (; x < width - 1; x += STREAM_CHUNK) {
+        int count = width - 1 - x < STREAM_CHUNK ? width - 1 - x : STREAM_CHUNK;
+        sobelPixels(up + x, mid + x, down + x, chunk, count);
+        streamChunk(out + x, chunk, count);
+    }
+}
+
+// Converts one row with convert(rgb, gray, count) (any grayscale row
+// kernel) into an L1-resident chunk and streams the chunk out, so the
+// output row never occupies cache.
+template <typename Convert>
+static inline void convertRowStream(const uint8_t* rgb, uint8_t* gray, int width, Convert convert) {
+    int head = (int)((16 - ((uintptr_t)gray & 15)) & 15);
+    if (head > width) {
+        head = width;
+    }
+    convert(rgb, gray, head);
+    int x = head;
+    alignas(16) uint8_t chunk[STREAM_CHUNK];
+    for (; x < width; x += STREAM_CHUNK) {
+        int count = width - x < STREAM_CHUNK ? width - x : STREAM_CHUNK;
+        convert(rgb + (size_t)x * 3, chunk, count);
+        streamChunk(gray + x, chunk, count);
+    }
+}
+
+// Packs row[x] > threshold into MSB-first bits, the same layout as
+// sobelBinaryRow, for a row that has already been filtered.
+static inline void packAboveRow(const uint8_t* row, uint8_t* bits, int width, int threshold) {
+    memset(bits, 0, (size_t)(width + 7) / 8);
+    if (threshold >= 255) {
+        return;
+    }
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i floor = _mm_set1_epi8((char)(threshold + 1));
+    for (; x + 16 <= width; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, floor), v));
+        bits[x / 8] = reverseBits((uint8_t)mask);
+        bits[x / 8 + 1] = reverseBits((uint8_t)(mask >> 8));
+    }
+#endif
+    for (; x < width; x++) {
+        if (row[x] > threshold) {
+            bits[x / 8] |= (uint8_t)(0x80 >> (x % 8));
+        }
+    }
+}
+
+// Calls visit(x) for every x in [x0, x1) with row[x] > threshold, in
+// increasing order. With SSE2, 16 pixels are compared at once and chunks
+// without an edge are skipped on a zero movemask, so the cost follows the
+// number of edge pixels rather than the row length.
+template <typename Visit>
+static inline void scanAbove(const uint8_t* row, int x0, int x1, int threshold, Visit visit) {
+    if (threshold >= 255) {
+        return;
+    }
+    int x = x0;
+#ifdef __SSE2__
+    const __m128i floor = _mm_set1_epi8((char)(threshold + 1));
+    for (; x + 16 <= x1; x += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(row + x));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, floor), v));
+        while (mask) {
+            visit(x + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; x < x1; x++) {
+        if (row[x] > threshold) {
+            visit(x);
+        }
+    }
+}
+
+// Splits one interleaved RGB row into three planes.
+static inline void deinterleaveRow(const uint8_t* rgb, uint8_t* red, uint8_t* green, uint8_t* blue, int width) {
+    #pragma omp simd
+    for (int x = 0; x < width; x++) {
+        red[x] = rgb[3 * x];
+        green[x] = rgb[3 * x + 1];
+        blue[x] = rgb[3 * x + 2];
+    }
+}
+
+static inline int sobelGradientX(const uint8_t* up, const uint8_t* mid, const uint8_t* down, int x) {
+    return (up[x + 1] - up[x - 1]) + 2 * (mid[x + 1] - mid[x - 1]) + (down[x + 1] - down[x - 1]);
+}
+
+static inline int sobelGradientY(const uint8_t* up, const uint8_t* down, int x) {
+    return (down[x - 1] + 2 * down[x] + down[x + 1]) - (up[x - 1] + 2 * up[x] + up[x + 1]);
+}
+
+// Colour edges for `count` pixels laid out as in sobelPixels, with one
+// up/mid/down row per channel. Max-channel takes the largest per-channel
+// |Gx| + |Gy|, so an edge between two colours of equal luma still shows.
+static inline void colorSobelMaxPixels(const uint8_t* const up[3], const uint8_t* const mid[3],
+                                       const uint8_t* const down[3], uint8_t* out, int count) {
+    const uint8_t *u0 = up[0], *u1 = up[1], *u2 = up[2];
+    const uint8_t *m0 = mid[0], *m1 = mid[1], *m2 = mid[2];
+    const uint8_t *d0 = down[0], *d1 = down[1], *d2 = down[2];
+    #pragma omp simd
+    for (int x = 0; x < count; x++) {
+        int red = abs(sobelGradientX(u0, m0, d0, x)) + abs(sobelGradientY(u0, d0, x));
+        int green = abs(sobelGradientX(u1, m1, d1, x)) + abs(sobelGradientY(u1, d1, x));
+        int blue = abs(sobelGradientX(u2, m2, d2, x)) + abs(sobelGradientY(u2, d2, x));
+        int gradient = red > green ? red : green;
+        gradient = blue > gradient ? blue : gradient;
+        out[x] = (uint8_t)(gradient > 255 ? 255 : gradient);
+    }
+}
+
+// Di Zenzo: the square root of the largest eigenvalue of the colour
+// structure tensor [sum gx^2, sum gx*gy; sum gx*gy, sum gy^2], divided by
+// sqrt(3) so a gray image gives sqrt(Gx^2 + Gy^2). Clamped to 255.
+// The tensor is built in 64-pixel chunks by a vectorized loop; the square
+// roots run as a separate SSE loop because sqrtf (which may set errno)
+// keeps the compiler from vectorizing it.
+#define DI_ZENZO_CHUNK 64
+
+static inline void colorSobelDiZenzoPixels(const uint8_t* const up[3], const uint8_t* const mid[3],
+                                           const uint8_t* const down[3], uint8_t* out, int count) {
+    const uint8_t *u0 = up[0], *u1 = up[1], *u2 = up[2];
+    const uint8_t *m0 = mid[0], *m1 = mid[1], *m2 = mid[2];
+    const uint8_t *d0 = down[0], *d1 = down[1], *d2 = down[2];
+    float trace[DI_ZENZO_CHUNK];
+    float discriminant[DI_ZENZO_CHUNK];
+    for (int base = 0; base < count; base += DI_ZENZO_CHUNK) {
+        int n = count - base < DI_ZENZO_CHUNK ? count - base : DI_ZENZO_CHUNK;
+        #pragma omp simd
+        for (int i = 0; i < n; i++) {
+            int x = base + i;
+            float rx = (float)sobelGradientX(u0, m0, d0, x), ry = (float)sobelGradientY(u0, d0, x);
+            float gx = (float)sobelGradientX(u1, m1, d1, x), gy = (float)sobelGradientY(u1, d1, x);
+            float bx = (float)sobelGradientX(u2, m2, d2, x), by = (float)sobelGradientY(u2, d2, x);
+            float gxx = rx * rx + gx * gx + bx * bx;
+            float gyy = ry * ry + gy * gy + by * by;
+            float gxy = rx * ry + gx * gy + bx * by;
+            trace[i] = gxx + gyy;
+            discriminant[i] = (gxx - gyy) * (gxx - gyy) + 4.0f * gxy * gxy;
+        }
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128 scale = _mm_set1_ps(0.5f / 3.0f);
+        const __m128 clamp = _mm_set1_ps(255.0f);
+        for (; i + 4 <= n; i += 4) {
+            __m128 root = _mm_sqrt_ps(_mm_loadu_ps(discriminant + i));
+            __m128 lambda = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(trace + i), root), scale);
+            __m128i gradient = _mm_cvttps_epi32(_mm_min_ps(_mm_sqrt_ps(lambda), clamp));
+            __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(gradient, zero), zero);
+            int packed = _mm_cvtsi128_si32(bytes);
+            memcpy(out + base + i, &packed, 4);
+        }
+#endif
+        for (; i < n; i++) {
+            float gradient = sqrtf(0.5f / 3.0f * (trace[i] + sqrtf(discriminant[i])));
+            out[base + i] = (uint8_t)(gradient > 255.0f ? 255.0f : gradient);
+        }
+    }
+}
+
+// Pixel types other than uint8_t (12/16-bit sensor data, float) go through
+// the templated kernels below; 8-bit input keeps the kernels above. The
+// accumulator is picked per pixel type at compile time: |Gx| + |Gy| of
+// 16-bit input needs 32-bit lanes (at most 524280); float accumulates in
+// float and is not clamped.
+template <typename Pixel> struct PixelTraits;
+
+// white() is the value the transfer function maps to 1; fromDouble()
+// stores a computed luma, rounded and clamped for integer types.
+template <> struct PixelTraits<uint16_t> {
+    typedef int32_t Accumulator;
+    static Accumulator maxValue() { return 65535; }
+    static double white() { return 65535.0; }
+    static uint16_t fromDouble(double value) {
+        return (uint16_t)(value >= 65535.0 ? 65535 : value + 0.5);
+    }
+};
+
+template <> struct PixelTraits<float> {
+    typedef float Accumulator;
+    static Accumulator maxValue() { return FLT_MAX; }
+    static double white() { return 1.0; }
+    static float fromDouble(double value) { return (float)value; }
+};
+
+// grayscaleRow for any pixel type; integer types truncate like the 8-bit row.
+template <typename Pixel>
+static inline void grayscaleRowT(const Pixel* rgb, Pixel* gray, int width) {
+    #pragma omp simd
+    for (int x = 0; x < width; x++) {
+        gray[x] = (Pixel)((0.3 * rgb[3 * x]) +
+                          (0.59 * rgb[3 * x + 1]) +
+                          (0.11 * rgb[3 * x + 2]));
+    }
+}
+
+// lumaRowFixed for any pixel type: a weighted sum of the encoded values.
+template <typename Pixel>
+static inline void lumaRowWeightedT(const Pixel* rgb, Pixel* gray, int width, const double weights[3]) {
+    const double wr = weights[0], wg = weights[1], wb = weights[2];
+    #pragma omp simd
+    for (int x = 0; x < width; x++) {
+        gray[x] = PixelTraits<Pixel>::fromDouble(wr * rgb[3 * x] + wg * rgb[3 * x + 1] + wb * rgb[3 * x + 2]);
+    }
+}
+
+// lumaRowLinear for any pixel type. 16-bit and float values are too many to
+// tabulate, so the transfer functions run per pixel, relative to
+// PixelTraits<Pixel>::white(); this costs far more than the 8-bit path.
+template <typename Pixel>
+static inline void lumaRowLinearT(const Pixel* rgb, Pixel* gray, int width, const double coefficients[3]) {
+    const double white = PixelTraits<Pixel>::white();
+    for (int x = 0; x < width; x++) {
+        double luminance = coefficients[0] * srgbToLinear(rgb[3 * x] / white) +
+                           coefficients[1] * srgbToLinear(rgb[3 * x + 1] / white) +
+                           coefficients[2] * srgbToLinear(rgb[3 * x + 2] / white);
+        gray[x] = PixelTraits<Pixel>::fromDouble(linearToSrgb(luminance) * white);
+    }
+}
+
+// sobelPixels for any pixel type, clamped to the type's maximum.
+template <typename Pixel>
+static inline void sobelPixelsT(const Pixel* up, const Pixel* mid, const Pixel* down,
+                                Pixel* out, int count) {
+    typedef typename PixelTraits<Pixel>::Accumulator Accumulator;
+    const Accumulator limit = PixelTraits<Pixel>::maxValue();
+    #pragma omp simd
+    for (int x = 0; x < count; x++) {
+        Accumulator gradient_x = (Accumulator)(((Accumulator)up[x + 1] - (Accumulator)up[x - 1]) +
+                                               2 * ((Accumulator)mid[x + 1] - (Accumulator)mid[x - 1]) +
+                                               ((Accumulator)down[x + 1] - (Accumulator)down[x - 1]));
+        Accumulator gradient_y = (Accumulator)(((Accumulator)down[x - 1] + 2 * (Accumulator)down[x] + (Accumulator)down[x + 1]) -
+                                               ((Accumulator)up[x - 1] + 2 * (Accumulator)up[x] + (Accumulator)up[x + 1]));
+        Accumulator gradient = (Accumulator)((gradient_x < 0 ? -gradient_x : gradient_x) +
+                                             (gradient_y < 0 ? -gradient_y : gradient_y));
+        out[x] = (Pixel)(gradient > limit ? limit : gradient);
+    }
+}
+
+// sobelRow for any pixel type.
+template <typename Pixel>
+static inline void sobelRowT(const Pixel* up, const Pixel* mid, const Pixel* down, Pixel* out, int width) {
+    out[0] = 0;
+    sobelPixelsT(up + 1, mid + 1, down + 1, out + 1, width - 2);
+    out[width - 1] = 0;
+}
+
+#endif // SOBEL_KERNELS_H
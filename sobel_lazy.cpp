@@ -0,0 +1,339 @@
+#include "sobel_lazy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "sobel_synthetic.h"
+
+// Coarse regions with nothing cached below them process their
+// full-resolution footprint in bands of about this many pixels.
+#define LAZY_BAND_PIXELS (1 << 20)
+
+LazyEdgeTiles::LazyEdgeTiles(size_t cache_bytes, int num_threads, int prefetch_threads)
+    : cache_bytes_(cache_bytes),
+      prefetch_threads_(prefetch_threads),
+      rgb_(NULL),
+      stride_(0),
+      width_(0),
+      height_(0),
+      levels_(0),
+      detector_(num_threads),
+      stopping_(false) {
+    initImageBuffer(&image_);
+    options_ = defaultPyramidOptions(PYRAMID_DZI);
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+LazyEdgeTiles::~LazyEdgeTiles() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        changed_.notify_all();
+    }
+    if (prefetcher_.joinable()) {
+        prefetcher_.join();
+    }
+    freeImageBuffer(&image_);
+}
+
+int LazyEdgeTiles::open(const char* source, const PyramidOptions& options) {
+    if (rgb_) {
+        return -1;
+    }
+    if (loadImageOrSynthetic(source, &image_) != 0) {
+        return -1;
+    }
+    return open(image_.data, (size_t)image_.width * 3, image_.width, image_.height, options);
+}
+
+int LazyEdgeTiles::open(const uint8_t* rgb, size_t stride, int width, int height, const PyramidOptions& options) {
+    if (rgb_ || !rgb || width <= 0 || height <= 0 || stride < (size_t)width * 3 || options.tile_size <= 0 ||
+        options.overlap < 0) {
+        return -1;
+    }
+    rgb_ = rgb;
+    stride_ = stride;
+    width_ = width;
+    height_ = height;
+    options_ = options;
+    levels_ = pyramidLevelCount(width, height, options);
+    if (prefetch_threads_ > 0) {
+        prefetcher_ = std::thread(&LazyEdgeTiles::prefetchLoop, this);
+    }
+    return 0;
+}
+
+void LazyEdgeTiles::levelSize(int level, int* level_width, int* level_height) const {
+    pyramidLevelSize(width_, height_, levels_, level, level_width, level_height);
+}
+
+uint64_t LazyEdgeTiles::tileKey(int level, int tx, int ty) {
+    return ((uint64_t)level << 48) | ((uint64_t)(uint32_t)ty << 24) | (uint32_t)tx;
+}
+
+bool LazyEdgeTiles::tileExists(int level, int tx, int ty) const {
+    if (!rgb_ || level < 0 || level >= levels_) {
+        return false;
+    }
+    int level_width, level_height;
+    levelSize(level, &level_width, &level_height);
+    return pyramidTileRegion(options_, level_width, level_height, tx, ty).width > 0;
+}
+
+int LazyEdgeTiles::computeTile(EdgeDetector& detector, int level, int tx, int ty,
+                               std::vector<uint8_t>* pixels, ImageRegion* region) {
+    int level_width, level_height;
+    levelSize(level, &level_width, &level_height);
+    *region = pyramidTileRegion(options_, level_width, level_height, tx, ty);
+    pixels->assign((size_t)region->width * region->height, 0);
+    return buildRegion(detector, level, *region, pixels->data());
+}
+
+// Fills out, zeroed and rect.width * rect.height, with rect of `level`. A
+// coarse pixel is the maximum of the 2x2 block below it at level + 1, taken
+// from the child tiles that are cached; the parts under missing children
+// are built the same way one level down. If no child is cached at all, the
+// full-resolution footprint is processed directly.
+int LazyEdgeTiles::buildRegion(EdgeDetector& detector, int level, const ImageRegion& rect, uint8_t* out) {
+    const int shift = levels_ - 1 - level;
+    if (shift == 0) {
+        return detector.processRegion(rgb_, stride_, width_, height_, rect.x, rect.y, rect.width, rect.height, out);
+    }
+
+    int child_width, child_height;
+    levelSize(level + 1, &child_width, &child_height);
+    const int size = options_.tile_size;
+    const int cx0 = rect.x * 2, cy0 = rect.y * 2;
+    const int cx1 = std::min((rect.x + rect.width) * 2, child_width);
+    const int cy1 = std::min((rect.y + rect.height) * 2, child_height);
+    std::vector<ImageRegion> parts;
+    std::vector<LazyTile> children;
+    bool any_cached = false;
+    for (int cty = cy0 / size; cty * size < cy1; cty++) {
+        for (int ctx = cx0 / size; ctx * size < cx1; ctx++) {
+            // The part of the child's own cells, not its overlap, under rect.
+            ImageRegion part;
+            part.x = std::max(cx0, ctx * size);
+            part.y = std::max(cy0, cty * size);
+            part.width = std::min(cx1, (ctx + 1) * size) - part.x;
+            part.height = std::min(cy1, (cty + 1) * size) - part.y;
+            LazyTile child;
+            any_cached |= peekTile(level + 1, ctx, cty, &child);
+            parts.push_back(part);
+            children.push_back(child);
+        }
+    }
+    if (!any_cached) {
+        return processFootprint(detector, shift, rect, out);
+    }
+
+    std::vector<uint8_t> missing;
+    for (size_t i = 0; i < parts.size(); i++) {
+        const ImageRegion& part = parts[i];
+        const uint8_t* pixels;
+        ImageRegion source;
+        if (children[i].pixels) {
+            pixels = children[i].pixels->data();
+            source = children[i].region;
+        } else {
+            missing.assign((size_t)part.width * part.height, 0);
+            if (buildRegion(detector, level + 1, part, missing.data()) != 0) {
+                return -1;
+            }
+            pixels = missing.data();
+            source = part;
+        }
+        for (int y = part.y; y < part.y + part.height; y++) {
+            const uint8_t* row = pixels + (size_t)(y - source.y) * source.width;
+            uint8_t* peaks = out + (size_t)((y >> 1) - rect.y) * rect.width;
+            for (int x = part.x; x < part.x + part.width; x++) {
+                uint8_t value = row[x - source.x];
+                uint8_t& peak = peaks[(x >> 1) - rect.x];
+                peak = value > peak ? value : peak;
+            }
+        }
+    }
+    return 0;
+}
+
+// Maximum over 2^shift x 2^shift blocks of rect's full-resolution
+// footprint, processed in bands of rows so memory stays bounded.
+int LazyEdgeTiles::processFootprint(EdgeDetector& detector, int shift, const ImageRegion& rect, uint8_t* out) {
+    const int64_t block = (int64_t)1 << shift;
+    const int fx0 = (int)(rect.x * block);
+    const int fy0 = (int)(rect.y * block);
+    const int fx1 = (int)std::min<int64_t>((rect.x + rect.width) * block, width_);
+    const int fy1 = (int)std::min<int64_t>((rect.y + rect.height) * block, height_);
+    const int footprint_width = fx1 - fx0;
+    int band = LAZY_BAND_PIXELS / footprint_width;
+    band = band < 1 ? 1 : band;
+    std::vector<uint8_t> edges((size_t)footprint_width * std::min(band, fy1 - fy0));
+
+    for (int y0 = fy0; y0 < fy1; y0 += band) {
+        int rows = std::min(band, fy1 - y0);
+        if (detector.processRegion(rgb_, stride_, width_, height_, fx0, y0, footprint_width, rows,
+                                   edges.data()) != 0) {
+            return -1;
+        }
+        for (int y = 0; y < rows; y++) {
+            const uint8_t* row = edges.data() + (size_t)y * footprint_width;
+            uint8_t* peaks = out + (size_t)(((y0 + y) >> shift) - rect.y) * rect.width;
+            for (int ox = 0; ox < rect.width; ox++) {
+                int x = (int)(ox * block);
+                int x1 = (int)std::min<int64_t>(x + block, footprint_width);
+                uint8_t peak = peaks[ox];
+                for (; x < x1; x++) {
+                    peak = row[x] > peak ? row[x] : peak;
+                }
+                peaks[ox] = peak;
+            }
+        }
+    }
+    return 0;
+}
+
+// The tile if it is cached, without waiting for or starting its computation.
+bool LazyEdgeTiles::peekTile(int level, int tx, int ty, LazyTile* tile) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<uint64_t, Entry>::iterator entry = entries_.find(tileKey(level, tx, ty));
+    if (entry == entries_.end()) {
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, entry->second.position);
+    tile->region = entry->second.region;
+    tile->pixels = entry->second.pixels;
+    return true;
+}
+
+void LazyEdgeTiles::insert(uint64_t key, std::shared_ptr<const std::vector<uint8_t> > pixels,
+                           const ImageRegion& region, bool prefetched) {
+    lru_.push_front(key);
+    stats_.bytes += pixels->size();
+    entries_[key] = Entry{pixels, region, lru_.begin(), prefetched, false};
+    // The new tile itself is never evicted, even if it alone is over budget.
+    while (stats_.bytes > cache_bytes_ && lru_.size() > 1) {
+        std::unordered_map<uint64_t, Entry>::iterator victim = entries_.find(lru_.back());
+        stats_.bytes -= victim->second.pixels->size();
+        entries_.erase(victim);
+        lru_.pop_back();
+        stats_.evictions++;
+    }
+    stats_.tiles = entries_.size();
+}
+
+int LazyEdgeTiles::getTile(int level, int tx, int ty, LazyTile* tile) {
+    if (!tile || !tileExists(level, tx, ty)) {
+        return -1;
+    }
+    const uint64_t key = tileKey(level, tx, ty);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stats_.requests++;
+        while (true) {
+            std::unordered_map<uint64_t, Entry>::iterator entry = entries_.find(key);
+            if (entry != entries_.end()) {
+                Entry& found = entry->second;
+                lru_.splice(lru_.begin(), lru_, found.position);
+                tile->region = found.region;
+                tile->pixels = found.pixels;
+                tile->origin = found.prefetched && !found.requested ? LAZY_TILE_PREFETCHED : LAZY_TILE_CACHED;
+                stats_.hits++;
+                stats_.prefetch_hits += tile->origin == LAZY_TILE_PREFETCHED;
+                found.requested = true;
+                lock.unlock();
+                schedulePrefetch(level, tx, ty);
+                return 0;
+            }
+            if (pending_.count(key) == 0) {
+                break;
+            }
+            changed_.wait(lock);
+        }
+        pending_.insert(key);
+        stats_.misses++;
+    }
+
+    std::shared_ptr<std::vector<uint8_t> > pixels = std::make_shared<std::vector<uint8_t> >();
+    ImageRegion region;
+    int status;
+    {
+        std::lock_guard<std::mutex> compute(compute_mutex_);
+        status = computeTile(detector_, level, tx, ty, pixels.get(), &region);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.erase(key);
+        if (status == 0) {
+            insert(key, pixels, region, false);
+            entries_[key].requested = true;
+        }
+        changed_.notify_all();
+    }
+    if (status != 0) {
+        return -1;
+    }
+    tile->region = region;
+    tile->pixels = pixels;
+    tile->origin = LAZY_TILE_COMPUTED;
+    schedulePrefetch(level, tx, ty);
+    return 0;
+}
+
+// Queues the eight neighbours of the tile just requested. Older queued
+// tiles are dropped: only the current view is worth computing ahead.
+void LazyEdgeTiles::schedulePrefetch(int level, int tx, int ty) {
+    if (prefetch_threads_ <= 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefetch_queue_.clear();
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            uint64_t key = tileKey(level, tx + dx, ty + dy);
+            if ((dx || dy) && tileExists(level, tx + dx, ty + dy) && entries_.count(key) == 0 &&
+                pending_.count(key) == 0) {
+                prefetch_queue_.push_back(key);
+            }
+        }
+    }
+    changed_.notify_all();
+}
+
+void LazyEdgeTiles::prefetchLoop() {
+    EdgeDetector detector(prefetch_threads_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        changed_.wait(lock, [this] { return stopping_ || !prefetch_queue_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        uint64_t key = prefetch_queue_.front();
+        prefetch_queue_.pop_front();
+        if (entries_.count(key) || pending_.count(key)) {
+            continue;
+        }
+        pending_.insert(key);
+        lock.unlock();
+
+        std::shared_ptr<std::vector<uint8_t> > pixels = std::make_shared<std::vector<uint8_t> >();
+        ImageRegion region;
+        int status = computeTile(detector, (int)(key >> 48), (int)(key & 0xFFFFFF), (int)((key >> 24) & 0xFFFFFF),
+                                 pixels.get(), &region);
+
+        lock.lock();
+        pending_.erase(key);
+        if (status == 0) {
+            insert(key, pixels, region, true);
+            stats_.prefetched++;
+        }
+        changed_.notify_all();
+    }
+}
+
+LazyTileStats LazyEdgeTiles::stats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,137 @@
+#ifndef SOBEL_LAZY_H
+#define SOBEL_LAZY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_pyramid.h"
+
+// On-demand edge tiles for interactive viewing. Nothing is computed when
+// an image is opened; getTile() computes a tile the first time it is asked
+// for and keeps it in a memory-bounded LRU cache. A background thread then
+// computes the tile's neighbours at the same level, so panning finds them
+// ready. Tiles use the pyramid geometry of sobel_pyramid.h and match the
+// tiles writeEdgePyramid() writes, except that XYZ edge tiles are not
+// padded.
+//
+// Full-resolution tiles run EdgeDetector::processRegion on the tile plus
+// its 1-pixel halo. A coarser tile is the 2x2 maximum of the tiles one level
+// finer that are cached, so zooming out from tiles already viewed costs
+// about the size of the tile. Only the parts with nothing cached below them
+// fall back to the maximum over blocks of their full-resolution footprint,
+// processed in bands of rows; that cost grows with the footprint.
+//
+// getTile() may be called from several threads. A tile being computed is
+// waited for, never computed twice.
+
+typedef enum {
+    LAZY_TILE_COMPUTED,    // computed for this request
+    LAZY_TILE_CACHED,      // computed by an earlier request
+    LAZY_TILE_PREFETCHED   // computed in the background before it was asked for
+} LazyTileOrigin;
+
+typedef struct {
+    ImageRegion region;  // position and size within its level
+    std::shared_ptr<const std::vector<uint8_t> > pixels;  // region.width * region.height, packed
+    LazyTileOrigin origin;
+} LazyTile;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t hits;           // including prefetch_hits
+    uint64_t prefetch_hits;
+    uint64_t misses;
+    uint64_t prefetched;     // tiles computed in the background
+    uint64_t evictions;
+    size_t tiles;            // currently cached
+    size_t bytes;
+} LazyTileStats;
+
+class LazyEdgeTiles {
+public:
+    // cache_bytes bounds the cached tile pixels. The foreground and the
+    // prefetcher each own an EdgeDetector; num_threads <= 0 uses
+    // omp_get_max_threads(), prefetch_threads 0 disables prefetching.
+    LazyEdgeTiles(size_t cache_bytes, int num_threads = 0, int prefetch_threads = 1);
+    ~LazyEdgeTiles();
+
+    LazyEdgeTiles(const LazyEdgeTiles&) = delete;
+    LazyEdgeTiles& operator=(const LazyEdgeTiles&) = delete;
+
+    // Decodes source (a JPEG or synthetic:<pattern>:<W>x<H>) and keeps the
+    // RGB pixels; the second form borrows caller-owned pixels, which must
+    // outlive this object. Each object opens one image, once.
+    // Returns 0 on success, -1 on failure.
+    int open(const char* source, const PyramidOptions& options);
+    int open(const uint8_t* rgb, size_t stride, int width, int height, const PyramidOptions& options);
+
+    int levels() const { return levels_; }
+    void levelSize(int level, int* level_width, int* level_height) const;
+    const PyramidOptions& options() const { return options_; }
+
+    // Tile (tx, ty) of `level`, computed now if it is not cached. The
+    // pixels stay valid for as long as the caller holds them, even if the
+    // tile is evicted. Returns -1 for a tile that does not exist.
+    int getTile(int level, int tx, int ty, LazyTile* tile);
+
+    LazyTileStats stats();
+
+private:
+    struct Entry {
+        std::shared_ptr<const std::vector<uint8_t> > pixels;
+        ImageRegion region;
+        std::list<uint64_t>::iterator position;  // in lru_
+        bool prefetched;
+        bool requested;
+    };
+
+    static uint64_t tileKey(int level, int tx, int ty);
+    bool tileExists(int level, int tx, int ty) const;
+    int computeTile(EdgeDetector& detector, int level, int tx, int ty,
+                    std::vector<uint8_t>* pixels, ImageRegion* region);
+    int buildRegion(EdgeDetector& detector, int level, const ImageRegion& rect, uint8_t* out);
+    int processFootprint(EdgeDetector& detector, int shift, const ImageRegion& rect, uint8_t* out);
+    bool peekTile(int level, int tx, int ty, LazyTile* tile);
+    // Called with mutex_ held.
+    void insert(uint64_t key, std::shared_ptr<const std::vector<uint8_t> > pixels,
+                const ImageRegion& region, bool prefetched);
+    void schedulePrefetch(int level, int tx, int ty);
+    void prefetchLoop();
+
+    size_t cache_bytes_;
+    int prefetch_threads_;
+    ImageBuffer image_;
+    const uint8_t* rgb_;
+    size_t stride_;
+    int width_;
+    int height_;
+    PyramidOptions options_;
+    int levels_;
+
+    EdgeDetector detector_;
+    std::mutex compute_mutex_;  // guards detector_
+
+    std::mutex mutex_;  // guards everything below
+    std::condition_variable changed_;
+    std::list<uint64_t> lru_;  // most recently used first
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::unordered_set<uint64_t> pending_;
+    std::deque<uint64_t> prefetch_queue_;
+    bool stopping_;
+    LazyTileStats stats_;
+    std::thread prefetcher_;
+};
+
+#endif // SOBEL_LAZY_H
@@ -0,0 +1,81 @@
+// Memory-lean edge detection for images close to the memory limit of a
+// node. EdgeDetector::processInPlace() turns the decoded RGB buffer into
+// the edge map, so the only image-sized allocation is the 3 B/px RGB
+// buffer. The default pipeline also holds a 1 B/px grayscale plane and a
+// 1 B/px edge plane, 5 B/px in total. The peak resident set size is
+// reported either way, to size how many jobs fit on a node.
+//
+//   g++ -O3 -march=native -fopenmp sobel_lean.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_synthetic.cpp sobel_perf.cpp -ljpeg -o sobel_lean
+//   ./sobel_lean [--standard] <input.jpg | synthetic:<pattern>:<W>x<H>> <output.jpg>
+//
+// --standard runs process() with separate planes instead, for comparison.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_perf.h"
+#include "sobel_synthetic.h"
+
+#define OUTPUT_QUALITY 95
+
+int main(int argc, char** argv) {
+    int first_arg = 1;
+    bool standard = false;
+    if (first_arg < argc && strcmp(argv[first_arg], "--standard") == 0) {
+        standard = true;
+        first_arg++;
+    }
+    if (argc != first_arg + 2) {
+        fprintf(stderr, "Usage: %s [--standard] <input.jpg | synthetic:<pattern>:<W>x<H>> <output.jpg>\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    if (loadImageOrSynthetic(argv[first_arg], &rgb) != 0) {
+        return EXIT_FAILURE;
+    }
+    const int width = rgb.width;
+    const int height = rgb.height;
+    const size_t stride = (size_t)width * 3;
+    const size_t after_load = peakResidentBytes();
+
+    EdgeDetector detector;
+    uint8_t* edges = NULL;
+    double start = omp_get_wtime();
+    int status;
+    if (standard) {
+        edges = (uint8_t*) malloc((size_t)width * height);
+        status = edges ? detector.process(rgb.data, stride, width, height, edges) : -1;
+    } else {
+        status = detector.processInPlace(rgb.data, stride, width, height);
+        edges = rgb.data;
+    }
+    double elapsed = omp_get_wtime() - start;
+    if (status != 0) {
+        fprintf(stderr, "Error: Edge detection failed.\n");
+        if (standard) {
+            free(edges);
+        }
+        freeImageBuffer(&rgb);
+        return EXIT_FAILURE;
+    }
+    const size_t peak = peakResidentBytes();
+
+    printf("Image %dx%d, %s mode\n", width, height, standard ? "standard" : "in-place");
+    printf("Time taken for edge detection: %f seconds\n", elapsed);
+    printf("Peak RSS: %.1f MB after load, %.1f MB after edge detection (%.2f B/px)\n",
+           after_load / 1048576.0, peak / 1048576.0, (double)peak / ((double)width * height));
+
+    int result = saveGrayJPEGFile(argv[first_arg + 1], edges, width, height, OUTPUT_QUALITY);
+    if (standard) {
+        free(edges);
+    }
+    freeImageBuffer(&rgb);
+    return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
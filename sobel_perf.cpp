@@ -0,0 +1,226 @@
+#include "sobel_perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <unistd.h>
+#include <omp.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <string>
+
+#define STREAM_RUNS 5
+
+static const char* const counter_names[PERF_COUNTER_COUNT] = {
+    "task-clock", "cycles", "instructions", "LLC-misses", "dTLB-misses"
+};
+
+const char* perfCounterName(PerfCounterId id) {
+    return id >= 0 && id < PERF_COUNTER_COUNT ? counter_names[id] : "?";
+}
+
+PerfSample perfDelta(const PerfSample& before, const PerfSample& after) {
+    PerfSample delta;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        delta.valid[i] = before.valid[i] && after.valid[i];
+        delta.values[i] = delta.valid[i] ? after.values[i] - before.values[i] : 0;
+    }
+    return delta;
+}
+
+void perfAccumulate(PerfSample* total, const PerfSample& sample) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        total->valid[i] = total->valid[i] && sample.valid[i];
+        total->values[i] += sample.values[i];
+    }
+}
+
+static int openEvent(uint32_t type, uint64_t config, pid_t pid, int cpu, bool exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = exclude_kernel;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, cpu, -1, 0);
+}
+
+ThreadCounters::ThreadCounters() {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        fds_[i] = -1;
+    }
+}
+
+ThreadCounters::~ThreadCounters() {
+    close();
+}
+
+int ThreadCounters::open() {
+    const struct { uint32_t type; uint64_t config; } events[PERF_COUNTER_COUNT] = {
+        {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                             ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+    close();
+    int opened = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        // pid 0, cpu -1: this thread, wherever it runs.
+        fds_[i] = openEvent(events[i].type, events[i].config, 0, -1, true);
+        opened += fds_[i] >= 0;
+    }
+    return opened;
+}
+
+void ThreadCounters::close() {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (fds_[i] >= 0) {
+            ::close(fds_[i]);
+            fds_[i] = -1;
+        }
+    }
+}
+
+void ThreadCounters::read(PerfSample* sample) const {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t value = 0;
+        sample->valid[i] = fds_[i] >= 0 && ::read(fds_[i], &value, sizeof(value)) == (ssize_t)sizeof(value);
+        sample->values[i] = sample->valid[i] ? value : 0;
+    }
+}
+
+MemoryTraffic::MemoryTraffic() {
+}
+
+MemoryTraffic::~MemoryTraffic() {
+    for (size_t i = 0; i < fds_.size(); i++) {
+        ::close(fds_[i]);
+    }
+}
+
+static bool readSysfsLine(const std::string& path, char* line, size_t size) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+    bool ok = fgets(line, (int)size, file) != NULL;
+    fclose(file);
+    return ok;
+}
+
+// Parses an event description such as "event=0x04,umask=0x03".
+static bool parseEventConfig(const char* text, uint64_t* config) {
+    unsigned event = 0, umask = 0;
+    const char* umask_text = strstr(text, "umask=");
+    if (sscanf(text, "event=%x", &event) != 1) {
+        return false;
+    }
+    if (umask_text) {
+        sscanf(umask_text, "umask=%x", &umask);
+    }
+    *config = event | ((uint64_t)umask << 8);
+    return true;
+}
+
+bool MemoryTraffic::open() {
+    glob_t found;
+    if (glob("/sys/bus/event_source/devices/uncore_imc*", 0, NULL, &found) != 0) {
+        return false;
+    }
+    for (size_t d = 0; d < found.gl_pathc; d++) {
+        std::string device = found.gl_pathv[d];
+        char line[256];
+        if (!readSysfsLine(device + "/type", line, sizeof(line))) {
+            continue;
+        }
+        uint32_t type = (uint32_t)atoi(line);
+        // Uncore PMUs count system-wide from one CPU of their package.
+        int cpu = readSysfsLine(device + "/cpumask", line, sizeof(line)) ? atoi(line) : 0;
+        const char* events[] = {"cas_count_read", "cas_count_write"};
+        for (int e = 0; e < 2; e++) {
+            uint64_t config;
+            if (!readSysfsLine(device + "/events/" + events[e], line, sizeof(line)) ||
+                !parseEventConfig(line, &config)) {
+                continue;
+            }
+            // The .scale file is in MiB per count (64-byte lines).
+            double scale = 64.0;
+            if (readSysfsLine(device + "/events/" + events[e] + ".scale", line, sizeof(line))) {
+                scale = atof(line) * 1048576.0;
+            }
+            int fd = openEvent(type, config, -1, cpu, false);
+            if (fd >= 0) {
+                fds_.push_back(fd);
+                scales_.push_back(scale);
+            }
+        }
+    }
+    globfree(&found);
+    return available();
+}
+
+uint64_t MemoryTraffic::bytes() const {
+    double total = 0.0;
+    for (size_t i = 0; i < fds_.size(); i++) {
+        uint64_t value = 0;
+        if (::read(fds_[i], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+            total += (double)value * scales_[i];
+        }
+    }
+    return (uint64_t)total;
+}
+
+size_t peakResidentBytes() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Linux reports kilobytes.
+    return (size_t)usage.ru_maxrss * 1024;
+}
+
+double measureStreamTriad(size_t elements, int threads) {
+    double* a = (double*) malloc(elements * sizeof(double));
+    double* b = (double*) malloc(elements * sizeof(double));
+    double* c = (double*) malloc(elements * sizeof(double));
+    if (!a || !b || !c) {
+        free(a);
+        free(b);
+        free(c);
+        return 0.0;
+    }
+    const long n = (long)elements;
+    // First touch from the same threads and schedule as the timed loop.
+    #pragma omp parallel for schedule(static) num_threads(threads)
+    for (long i = 0; i < n; i++) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+
+    double best = 0.0;
+    for (int run = 0; run < STREAM_RUNS; run++) {
+        double start = omp_get_wtime();
+        #pragma omp parallel for schedule(static) num_threads(threads)
+        for (long i = 0; i < n; i++) {
+            a[i] = b[i] + 3.0 * c[i];
+        }
+        double elapsed = omp_get_wtime() - start;
+        double rate = 3.0 * sizeof(double) * (double)elements / elapsed / 1e9;
+        best = rate > best ? rate : best;
+    }
+    // Keep the result live so the loop is not optimized away.
+    if (a[n / 2] != 7.0) {
+        fprintf(stderr, "Warning: STREAM triad check failed.\n");
+    }
+    free(a);
+    free(b);
+    free(c);
+    return best;
+}
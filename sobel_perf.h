@@ -0,0 +1,83 @@
+#ifndef SOBEL_PERF_H
+#define SOBEL_PERF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+// Linux hardware counters through perf_event_open, for finding out whether
+// a stage is memory- or compute-bound. Every counter is optional: when the
+// kernel or the machine (VMs often have no PMU) refuses one, it is
+// reported as unavailable and everything else keeps working.
+
+typedef enum {
+    PERF_TASK_CLOCK,    // software, ns on CPU; almost always available
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,   // dTLB read misses
+    PERF_COUNTER_COUNT
+} PerfCounterId;
+
+typedef struct {
+    uint64_t values[PERF_COUNTER_COUNT];
+    bool valid[PERF_COUNTER_COUNT];
+} PerfSample;
+
+const char* perfCounterName(PerfCounterId id);
+
+// after - before, per counter; a counter is valid only if it was in both.
+PerfSample perfDelta(const PerfSample& before, const PerfSample& after);
+void perfAccumulate(PerfSample* total, const PerfSample& sample);
+
+// Counters of the calling thread (user space only). Open and read from the
+// thread being measured, e.g. inside an OpenMP parallel region.
+class ThreadCounters {
+public:
+    ThreadCounters();
+    ~ThreadCounters();
+
+    ThreadCounters(const ThreadCounters&) = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    // Returns the number of counters that could be opened.
+    int open();
+    void close();
+    void read(PerfSample* sample) const;
+
+private:
+    int fds_[PERF_COUNTER_COUNT];
+};
+
+// Memory-controller traffic from the uncore IMC PMUs (uncore_imc_*
+// cas_count_read/write), system-wide. Needs perf_event_paranoid <= 0 or
+// CAP_PERFMON, and a host that exposes the PMUs.
+class MemoryTraffic {
+public:
+    MemoryTraffic();
+    ~MemoryTraffic();
+
+    MemoryTraffic(const MemoryTraffic&) = delete;
+    MemoryTraffic& operator=(const MemoryTraffic&) = delete;
+
+    bool open();
+    bool available() const { return !fds_.empty(); }
+    // DRAM bytes read plus written since open().
+    uint64_t bytes() const;
+
+private:
+    std::vector<int> fds_;
+    std::vector<double> scales_;  // bytes per count
+};
+
+// Peak resident set size of this process so far (getrusage ru_maxrss), in
+// bytes; 0 if unavailable.
+size_t peakResidentBytes();
+
+// STREAM triad (a[i] = b[i] + s * c[i]) over three arrays of `elements`
+// doubles on `threads` threads; best of several runs, in GB/s counted the
+// STREAM way (24 bytes per element, no write-allocate traffic).
+double measureStreamTriad(size_t elements, int threads);
+
+#endif // SOBEL_PERF_H
@@ -0,0 +1,82 @@
+// Progressive edge detection for interactive use: a 1/8-scale edge map
+// first, then 1/2, then full resolution. Each level decodes the JPEG at its
+// own scale with libjpeg's DCT scaling (loadJPEGFileScaled), runs Sobel on
+// its own buffers and writes its own file, so a viewer can show the first
+// preview long before the full-size map is ready.
+//
+//   g++ -O3 -march=native -fopenmp sobel_preview.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp -ljpeg -o sobel_preview
+//   ./sobel_preview <input.jpg> <output.jpg>
+//
+// Writes <output>_1-8.jpg, <output>_1-2.jpg and <output>.jpg, in that
+// order, and prints each file's name and time since start as soon as it
+// is written.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <string>
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+
+#define OUTPUT_QUALITY 95
+
+static const int preview_scales[] = {8, 2, 1};
+
+static std::string levelPath(const std::string& output, int scale) {
+    if (scale == 1) {
+        return output;
+    }
+    size_t dot = output.find_last_of('.');
+    size_t slash = output.find_last_of('/');
+    std::string stem = output, extension;
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+        stem = output.substr(0, dot);
+        extension = output.substr(dot);
+    }
+    return stem + "_1-" + std::to_string(scale) + extension;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <input.jpg> <output.jpg>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    EdgeDetector detector;
+    double start = omp_get_wtime();
+    double level_start = start;
+
+    for (size_t level = 0; level < sizeof(preview_scales) / sizeof(preview_scales[0]); level++) {
+        int scale = preview_scales[level];
+        ImageBuffer rgb;
+        initImageBuffer(&rgb);
+        if (loadJPEGFileScaled(argv[1], scale, &rgb) != 0) {
+            return EXIT_FAILURE;
+        }
+        const int width = rgb.width;
+        const int height = rgb.height;
+        double decoded = omp_get_wtime();
+        std::vector<uint8_t> edges((size_t)width * height);
+        if (detector.process(rgb.data, (size_t)width * 3, width, height, edges.data()) != 0) {
+            fprintf(stderr, "Error: Edge detection failed at 1/%d.\n", scale);
+            freeImageBuffer(&rgb);
+            return EXIT_FAILURE;
+        }
+        freeImageBuffer(&rgb);
+        double detected = omp_get_wtime();
+        std::string path = levelPath(argv[2], scale);
+        if (saveGrayJPEGFile(path.c_str(), edges.data(), width, height, OUTPUT_QUALITY) != 0) {
+            return EXIT_FAILURE;
+        }
+        double written = omp_get_wtime();
+        printf("1/%d %dx%d -> %s (decode %.3f s, edges %.3f s, write %.3f s), ready after %f seconds\n",
+               scale, width, height, path.c_str(), decoded - level_start, detected - decoded,
+               written - detected, written - start);
+        fflush(stdout);
+        level_start = written;
+    }
+    return 0;
+}
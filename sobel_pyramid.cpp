@@ -0,0 +1,224 @@
+#include "sobel_pyramid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <omp.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#define DEFAULT_TILE_QUALITY 95
+
+PyramidOptions defaultPyramidOptions(PyramidLayout layout) {
+    PyramidOptions options;
+    options.layout = layout;
+    options.tile_size = layout == PYRAMID_DZI ? 254 : 256;
+    options.overlap = layout == PYRAMID_DZI ? 1 : 0;
+    options.quality = DEFAULT_TILE_QUALITY;
+    return options;
+}
+
+int pyramidLevelCount(int width, int height, const PyramidOptions& options) {
+    // DZI halves down to 1x1; XYZ stops once the level fits in one tile.
+    int limit = options.layout == PYRAMID_DZI ? 1 : options.tile_size;
+    int size = width > height ? width : height;
+    int levels = 1;
+    while (size > limit) {
+        size = (size + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+void pyramidLevelSize(int width, int height, int levels, int level, int* level_width, int* level_height) {
+    // Repeated halving with rounding up, exactly as downsampleEdges does.
+    for (int i = level; i < levels - 1; i++) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    *level_width = width;
+    *level_height = height;
+}
+
+ImageRegion pyramidTileRegion(const PyramidOptions& options, int level_width, int level_height,
+                              int tx, int ty) {
+    ImageRegion region = {0, 0, 0, 0};
+    const int size = options.tile_size;
+    const int overlap = options.layout == PYRAMID_DZI ? options.overlap : 0;
+    if (tx < 0 || ty < 0 || (size_t)tx * size >= (size_t)level_width || (size_t)ty * size >= (size_t)level_height) {
+        return region;
+    }
+    region.x = tx * size - (tx > 0 ? overlap : 0);
+    region.y = ty * size - (ty > 0 ? overlap : 0);
+    int x1 = (tx + 1) * size + overlap, y1 = (ty + 1) * size + overlap;
+    region.width = (x1 < level_width ? x1 : level_width) - region.x;
+    region.height = (y1 < level_height ? y1 : level_height) - region.y;
+    return region;
+}
+
+void downsampleEdges(const uint8_t* edges, int width, int height, uint8_t* out, int num_threads) {
+    const int out_width = (width + 1) / 2, out_height = (height + 1) / 2;
+    if (num_threads <= 0) {
+        num_threads = omp_get_max_threads();
+    }
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int y = 0; y < out_height; y++) {
+        const uint8_t* top = edges + (size_t)(2 * y) * width;
+        // An odd last row pairs with itself.
+        const uint8_t* bottom = 2 * y + 1 < height ? top + width : top;
+        uint8_t* row = out + (size_t)y * out_width;
+        for (int x = 0; x < width / 2; x++) {
+            uint8_t a = top[2 * x] > top[2 * x + 1] ? top[2 * x] : top[2 * x + 1];
+            uint8_t b = bottom[2 * x] > bottom[2 * x + 1] ? bottom[2 * x] : bottom[2 * x + 1];
+            row[x] = a > b ? a : b;
+        }
+        if (width & 1) {
+            uint8_t a = top[width - 1], b = bottom[width - 1];
+            row[out_width - 1] = a > b ? a : b;
+        }
+    }
+}
+
+static int makeDirectory(const std::string& path) {
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Unable to create directory %s.\n", path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+static std::string tilePath(const std::string& base, const PyramidOptions& options, int level, int tx, int ty) {
+    char name[64];
+    if (options.layout == PYRAMID_DZI) {
+        snprintf(name, sizeof(name), "_files/%d/%d_%d.jpg", level, tx, ty);
+    } else {
+        snprintf(name, sizeof(name), "/%d/%d/%d.jpg", level, tx, ty);
+    }
+    return base + name;
+}
+
+// Creates the directories of every level (and, for XYZ, every column) and
+// the DZI descriptor, before any tile is written in parallel.
+static int prepareLayout(const std::string& base, const PyramidOptions& options, int width, int height,
+                         int levels) {
+    std::string root = options.layout == PYRAMID_DZI ? base + "_files" : base;
+    if (makeDirectory(root) != 0) {
+        return -1;
+    }
+    for (int level = 0; level < levels; level++) {
+        std::string dir = root + "/" + std::to_string(level);
+        if (makeDirectory(dir) != 0) {
+            return -1;
+        }
+        if (options.layout == PYRAMID_XYZ) {
+            int level_width, level_height;
+            pyramidLevelSize(width, height, levels, level, &level_width, &level_height);
+            int columns = (level_width + options.tile_size - 1) / options.tile_size;
+            for (int tx = 0; tx < columns; tx++) {
+                if (makeDirectory(dir + "/" + std::to_string(tx)) != 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    if (options.layout == PYRAMID_DZI) {
+        std::string descriptor = base + ".dzi";
+        FILE* file = fopen(descriptor.c_str(), "w");
+        if (!file) {
+            fprintf(stderr, "Error: Unable to open file %s for writing.\n", descriptor.c_str());
+            return -1;
+        }
+        fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                      "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" Format=\"jpg\" "
+                      "Overlap=\"%d\" TileSize=\"%d\">\n"
+                      "  <Size Width=\"%d\" Height=\"%d\"/>\n"
+                      "</Image>\n", options.overlap, options.tile_size, width, height);
+        if (fclose(file) != 0) {
+            fprintf(stderr, "Error: Unable to finish writing %s.\n", descriptor.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Encodes every tile of one level, in parallel; returns the failure count.
+static int writeLevel(const uint8_t* plane, int level_width, int level_height, int level,
+                      const std::string& base, const PyramidOptions& options, int num_threads) {
+    const int columns = (level_width + options.tile_size - 1) / options.tile_size;
+    const int rows = (level_height + options.tile_size - 1) / options.tile_size;
+    const int tiles = columns * rows;
+    const bool pad = options.layout == PYRAMID_XYZ;
+    int failures = 0;
+
+    #pragma omp parallel num_threads(num_threads) reduction(+:failures)
+    {
+        std::vector<uint8_t> tile;
+        #pragma omp for schedule(dynamic)
+        for (int t = 0; t < tiles; t++) {
+            int tx = t % columns, ty = t / columns;
+            ImageRegion region = pyramidTileRegion(options, level_width, level_height, tx, ty);
+            int tile_width = pad ? options.tile_size : region.width;
+            int tile_height = pad ? options.tile_size : region.height;
+            tile.assign((size_t)tile_width * tile_height, 0);
+            for (int y = 0; y < region.height; y++) {
+                memcpy(&tile[(size_t)y * tile_width], plane + (size_t)(region.y + y) * level_width + region.x,
+                       region.width);
+            }
+            std::string path = tilePath(base, options, level, tx, ty);
+            if (saveGrayJPEGFile(path.c_str(), tile.data(), tile_width, tile_height, options.quality) != 0) {
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+int writeEdgePyramid(const uint8_t* edges, int width, int height, const char* base,
+                     const PyramidOptions& options, int num_threads, PyramidStats* stats) {
+    if (!edges || !base || width <= 0 || height <= 0 || options.tile_size <= 0 || options.overlap < 0 ||
+        options.quality < 1 || options.quality > 100) {
+        fprintf(stderr, "Error: Invalid pyramid parameters.\n");
+        return -1;
+    }
+    if (num_threads <= 0) {
+        num_threads = omp_get_max_threads();
+    }
+    const int levels = pyramidLevelCount(width, height, options);
+    if (prepareLayout(base, options, width, height, levels) != 0) {
+        return -1;
+    }
+    PyramidStats local = {levels, 0, 0.0, 0.0};
+
+    // Two buffers alternate as the source and destination of each halving.
+    std::vector<uint8_t> buffers[2];
+    const uint8_t* plane = edges;
+    int level_width = width, level_height = height;
+    int failures = 0;
+    for (int level = levels - 1; level >= 0; level--) {
+        double start = omp_get_wtime();
+        if (level < levels - 1) {
+            std::vector<uint8_t>& next = buffers[level & 1];
+            next.resize((size_t)((level_width + 1) / 2) * ((level_height + 1) / 2));
+            downsampleEdges(plane, level_width, level_height, next.data(), num_threads);
+            plane = next.data();
+            level_width = (level_width + 1) / 2;
+            level_height = (level_height + 1) / 2;
+        }
+        failures += writeLevel(plane, level_width, level_height, level, base, options, num_threads);
+        local.tiles += (size_t)((level_width + options.tile_size - 1) / options.tile_size) *
+                       ((level_height + options.tile_size - 1) / options.tile_size);
+        double elapsed = omp_get_wtime() - start;
+        if (level == levels - 1) {
+            local.full_time += elapsed;
+        } else {
+            local.coarse_time += elapsed;
+        }
+    }
+    if (stats) {
+        *stats = local;
+    }
+    return failures == 0 ? 0 : -1;
+}
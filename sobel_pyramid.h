@@ -0,0 +1,64 @@
+#ifndef SOBEL_PYRAMID_H
+#define SOBEL_PYRAMID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sobel_jpeg_io.h"
+
+// Edge maps as tile pyramids that image viewers can open at any size,
+// unlike one flat JPEG of several hundred megapixels.
+//
+// Level numbering is coarse to fine; the last level is full resolution and
+// each coarser one is half the size of the next, rounded up. Deep Zoom
+// (DZI) starts at a 1x1 level, as its viewers expect, and tiles overlap by
+// `overlap` pixels on each inner side. XYZ starts at the level that fits in
+// one tile and has no overlap; its edge tiles are padded with 0 (no edge)
+// to the full tile size, since slippy-map viewers assume square tiles.
+typedef enum {
+    PYRAMID_DZI,  // <base>.dzi and <base>_files/<level>/<column>_<row>.jpg
+    PYRAMID_XYZ   // <base>/<z>/<x>/<y>.jpg
+} PyramidLayout;
+
+typedef struct {
+    PyramidLayout layout;
+    int tile_size;
+    int overlap;   // DZI only
+    int quality;   // JPEG quality of the tiles
+} PyramidOptions;
+
+typedef struct {
+    int levels;
+    size_t tiles;
+    double full_time;    // seconds encoding the full-resolution tiles
+    double coarse_time;  // seconds downsampling and encoding the coarser levels
+} PyramidStats;
+
+// 254-pixel tiles with 1 pixel of overlap for DZI (the Deep Zoom default,
+// 256 with the overlap), 256-pixel tiles for XYZ; quality 95.
+PyramidOptions defaultPyramidOptions(PyramidLayout layout);
+
+// Geometry shared by the writer and by lazy tile access.
+int pyramidLevelCount(int width, int height, const PyramidOptions& options);
+// Size of `level` of a width x height image.
+void pyramidLevelSize(int width, int height, int levels, int level, int* level_width, int* level_height);
+// Pixels of tile (tx, ty) within a level_width x level_height level,
+// including the overlap; empty (width 0) if the tile does not exist.
+ImageRegion pyramidTileRegion(const PyramidOptions& options, int level_width, int level_height,
+                              int tx, int ty);
+
+// 2x2 downsample of a packed edge plane to ceil(width / 2) x ceil(height / 2),
+// keeping the maximum of each block: averaging would fade 1-pixel edges
+// away within a few levels.
+void downsampleEdges(const uint8_t* edges, int width, int height, uint8_t* out, int num_threads);
+
+// Writes the pyramid of a packed width x height edge map. The
+// full-resolution tiles are cut straight from `edges` with no flat image
+// written first; each coarser level is downsampled in parallel from the
+// one above it. Tiles of a level are encoded and written in parallel
+// (num_threads <= 0 uses omp_get_max_threads()). Returns 0 on success,
+// -1 on failure (message on stderr).
+int writeEdgePyramid(const uint8_t* edges, int width, int height, const char* base,
+                     const PyramidOptions& options, int num_threads, PyramidStats* stats);
+
+#endif // SOBEL_PYRAMID_H
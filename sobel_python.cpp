@@ -0,0 +1,218 @@
+// CPython bindings for EdgeDetector.
+//
+// Images are read through the buffer protocol, so NumPy arrays (and any
+// other exporter with a compatible layout) are used in place. The edge map
+// is written straight into a freshly allocated numpy.uint8 array, and the
+// GIL is released while the OpenMP passes run.
+//
+//   g++ -O3 -march=native -fopenmp -fPIC -shared $(python3-config --includes)
+//       sobel_python.cpp sobel_edge_detector.cpp -o sobel_omp$(python3-config --extension-suffix)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+
+#include <new>
+
+#include "sobel_edge_detector.h"
+
+typedef struct {
+    PyObject_HEAD
+    EdgeDetector* detector;
+    PyThread_type_lock lock;
+} DetectorObject;
+
+static PyObject* numpy_empty = NULL;
+static PyObject* numpy_uint8 = NULL;
+
+static int loadNumpy() {
+    if (numpy_empty) {
+        return 0;
+    }
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if (!numpy) {
+        return -1;
+    }
+    numpy_empty = PyObject_GetAttrString(numpy, "empty");
+    numpy_uint8 = PyObject_GetAttrString(numpy, "uint8");
+    Py_DECREF(numpy);
+    if (!numpy_empty || !numpy_uint8) {
+        Py_CLEAR(numpy_empty);
+        Py_CLEAR(numpy_uint8);
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject* newEdgeArray(Py_ssize_t height, Py_ssize_t width) {
+    if (loadNumpy() != 0) {
+        return NULL;
+    }
+    return PyObject_CallFunction(numpy_empty, "((nn)O)", height, width, numpy_uint8);
+}
+
+static int Detector_init(DetectorObject* self, PyObject* args, PyObject* kwds) {
+    static const char* kwlist[] = {"num_threads", NULL};
+    int num_threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|i", (char**) kwlist, &num_threads)) {
+        return -1;
+    }
+    if (!self->lock) {
+        self->lock = PyThread_allocate_lock();
+        if (!self->lock) {
+            PyErr_NoMemory();
+            return -1;
+        }
+    }
+    EdgeDetector* detector = new (std::nothrow) EdgeDetector(num_threads);
+    if (!detector) {
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    // __init__ may run again while another thread is inside process() with
+    // the GIL released. Wait for the lock without the GIL, then swap with
+    // both held so neither process() nor the getters see a freed detector.
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    EdgeDetector* previous = self->detector;
+    self->detector = detector;
+    PyThread_release_lock(self->lock);
+    delete previous;
+    return 0;
+}
+
+static void Detector_dealloc(DetectorObject* self) {
+    delete self->detector;
+    if (self->lock) {
+        PyThread_free_lock(self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject*) self);
+}
+
+// Accepts (H, W) grayscale or (H, W, 3) RGB uint8 data. Rows may be padded,
+// but pixels must be contiguous within a row.
+static PyObject* Detector_process(DetectorObject* self, PyObject* args) {
+    PyObject* image;
+    if (!PyArg_ParseTuple(args, "O", &image)) {
+        return NULL;
+    }
+    if (!self->detector) {
+        PyErr_SetString(PyExc_RuntimeError, "Detector is not initialized");
+        return NULL;
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(image, &view, PyBUF_STRIDES | PyBUF_FORMAT) != 0) {
+        return NULL;
+    }
+
+    const char* format = view.format ? view.format : "B";
+    bool is_u8 = (format[0] == 'B' && format[1] == '\0') || (format[0] == '=' && format[1] == 'B');
+    bool is_gray = view.ndim == 2 && view.strides[1] == 1;
+    bool is_rgb = view.ndim == 3 && view.shape[2] == 3 && view.strides[2] == 1 && view.strides[1] == 3;
+    if (!is_u8 || view.itemsize != 1 || !(is_gray || is_rgb) || view.strides[0] <= 0) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError,
+                        "expected a uint8 array of shape (H, W) or (H, W, 3) with contiguous rows");
+        return NULL;
+    }
+
+    Py_ssize_t height = view.shape[0];
+    Py_ssize_t width = view.shape[1];
+    if (height > INT32_MAX || width > INT32_MAX) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "image is too large");
+        return NULL;
+    }
+
+    PyObject* result = newEdgeArray(height, width);
+    if (!result) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    Py_buffer out;
+    if (PyObject_GetBuffer(result, &out, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE) != 0) {
+        PyBuffer_Release(&view);
+        Py_DECREF(result);
+        return NULL;
+    }
+
+    int status;
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    if (is_gray) {
+        status = self->detector->processGray((const uint8_t*) view.buf, (size_t) view.strides[0],
+                                             (int) width, (int) height, (uint8_t*) out.buf);
+    } else {
+        status = self->detector->process((const uint8_t*) view.buf, (size_t) view.strides[0],
+                                         (int) width, (int) height, (uint8_t*) out.buf);
+    }
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&out);
+    PyBuffer_Release(&view);
+    if (status != 0) {
+        Py_DECREF(result);
+        PyErr_SetString(PyExc_RuntimeError, "edge detection failed");
+        return NULL;
+    }
+    return result;
+}
+
+static PyObject* Detector_num_threads(DetectorObject* self, void*) {
+    return PyLong_FromLong(self->detector ? self->detector->numThreads() : 0);
+}
+
+static PyMethodDef Detector_methods[] = {
+    {"process", (PyCFunction) Detector_process, METH_VARARGS,
+     "process(image) -> numpy.ndarray\n\n"
+     "Sobel edge map of a (H, W) grayscale or (H, W, 3) RGB uint8 array."},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef Detector_getset[] = {
+    {"num_threads", (getter) Detector_num_threads, NULL, "OpenMP team size", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject DetectorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+};
+
+static PyModuleDef sobel_module = {
+    PyModuleDef_HEAD_INIT,
+    "sobel_omp",
+    "OpenMP Sobel edge detection over NumPy arrays.",
+    -1,
+    NULL,
+};
+
+PyMODINIT_FUNC PyInit_sobel_omp(void) {
+    DetectorType.tp_name = "sobel_omp.Detector";
+    DetectorType.tp_doc = "Detector(num_threads=0)\n\nReusable edge detector with its own buffers.";
+    DetectorType.tp_basicsize = sizeof(DetectorObject);
+    DetectorType.tp_flags = Py_TPFLAGS_DEFAULT;
+    DetectorType.tp_new = PyType_GenericNew;
+    DetectorType.tp_init = (initproc) Detector_init;
+    DetectorType.tp_dealloc = (destructor) Detector_dealloc;
+    DetectorType.tp_methods = Detector_methods;
+    DetectorType.tp_getset = Detector_getset;
+    if (PyType_Ready(&DetectorType) < 0) {
+        return NULL;
+    }
+
+    PyObject* module = PyModule_Create(&sobel_module);
+    if (!module) {
+        return NULL;
+    }
+    Py_INCREF(&DetectorType);
+    if (PyModule_AddObject(module, "Detector", (PyObject*) &DetectorType) < 0) {
+        Py_DECREF(&DetectorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
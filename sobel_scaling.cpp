@@ -0,0 +1,238 @@
+// Strong- and weak-scaling study of the EdgeDetector engines on synthetic
+// images (sobel_synthetic.h), so the numbers can be reproduced without a
+// local Large_image.jpg.
+//
+// Strong scaling keeps the image fixed and adds threads; efficiency is
+// T(1) / (n * T(n)). Weak scaling grows the image with the thread count,
+// weak-size x weak-size pixels per thread (whole rows, so the row length
+// stays the same), and efficiency is T(1) / T(n). If the thread list does
+// not start at 1, its first entry is the baseline and is assumed to have
+// scaled perfectly.
+//
+//   g++ -O3 -march=native -fopenmp sobel_scaling.cpp sobel_edge_detector.cpp sobel_synthetic.cpp sobel_jpeg_io.cpp -ljpeg -o sobel_scaling
+//   ./sobel_scaling [options]
+//
+// Options:
+//   --pattern <gradient|checkerboard|noise|natural>   image content (natural)
+//   --sizes <n,n,...>     square image sizes for strong scaling (1024,2048,4096)
+//   --threads <n,n,...>   thread counts (powers of two up to the core count)
+//   --weak-size <n>       pixels per thread for weak scaling, n x n (1024)
+//   --repeats <n>         timed runs per point; the best is kept (5)
+//   --engine <name>       only this engine; may be repeated
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_synthetic.h"
+
+#define BINARY_THRESHOLD 128
+
+// Output buffers for one image size, shared by all engines.
+typedef struct {
+    std::vector<uint8_t> edges;
+    std::vector<int16_t> gx;
+    std::vector<int16_t> gy;
+    std::vector<uint8_t> bits;
+    size_t gradient_stride;
+    size_t bits_stride;
+} ScalingOutputs;
+
+typedef int (*EngineRun)(EdgeDetector& detector, const ImageBuffer& image, ScalingOutputs& out);
+
+static int runProcess(EdgeDetector& detector, const ImageBuffer& image, ScalingOutputs& out) {
+    return detector.process(image.data, (size_t)image.width * 3, image.width, image.height, out.edges.data());
+}
+
+static int runColor(EdgeDetector& detector, const ImageBuffer& image, ScalingOutputs& out) {
+    return detector.processColor(image.data, (size_t)image.width * 3, image.width, image.height,
+                                 SOBEL_COLOR_MAX_CHANNEL, out.edges.data());
+}
+
+static int runGradients(EdgeDetector& detector, const ImageBuffer& image, ScalingOutputs& out) {
+    return detector.processGradients(image.data, (size_t)image.width * 3, image.width, image.height,
+                                     out.edges.data(), out.gx.data(), out.gy.data(), out.gradient_stride);
+}
+
+static int runBinary(EdgeDetector& detector, const ImageBuffer& image, ScalingOutputs& out) {
+    return detector.processBinary(image.data, (size_t)image.width * 3, image.width, image.height,
+                                  BINARY_THRESHOLD, out.bits.data(), out.bits_stride);
+}
+
+// process() runs in whichever mode the tuning selects; the other engines
+// ignore band_rows and streaming_stores.
+static const struct {
+    const char* name;
+    EngineRun run;
+    int band_rows;
+    int streaming_stores;
+} engines[] = {
+    {"two-pass", runProcess, 0, 0},
+    {"bands", runProcess, 32, 0},
+    {"streaming", runProcess, 0, 1},
+    {"color", runColor, 0, 0},
+    {"gradients", runGradients, 0, 0},
+    {"binary", runBinary, 0, 0},
+};
+static const int engine_count = (int)(sizeof(engines) / sizeof(engines[0]));
+
+static void prepareOutputs(ScalingOutputs* out, int width, int height) {
+    out->edges.resize((size_t)width * height);
+    out->gradient_stride = sobel_gradient_stride(width);
+    out->gx.resize(out->gradient_stride * height);
+    out->gy.resize(out->gradient_stride * height);
+    out->bits_stride = ((size_t)width + 7) / 8;
+    out->bits.resize(out->bits_stride * height);
+}
+
+// Best of `repeats` timed runs after one warm-up, in seconds; negative on
+// failure.
+static double timeEngine(int engine, int threads, const ImageBuffer& image, ScalingOutputs& out,
+                         int repeats) {
+    EdgeDetector detector(threads);
+    EdgeTuning tuning = detector.tuning();
+    tuning.band_rows = engines[engine].band_rows;
+    tuning.streaming_stores = engines[engine].streaming_stores;
+    if (detector.setTuning(tuning) != 0 || engines[engine].run(detector, image, out) != 0) {
+        return -1.0;
+    }
+    double best = 0.0;
+    for (int i = 0; i < repeats; i++) {
+        double start = omp_get_wtime();
+        engines[engine].run(detector, image, out);
+        double elapsed = omp_get_wtime() - start;
+        best = i == 0 || elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+static int findEngine(const char* name) {
+    for (int i = 0; i < engine_count; i++) {
+        if (strcmp(engines[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    SyntheticPattern pattern = SYNTHETIC_NATURAL;
+    std::vector<int> sizes = {1024, 2048, 4096};
+    std::vector<int> thread_counts;
+    std::vector<int> selected;
+    int weak_size = 1024;
+    int repeats = 5;
+
+    const int procs = omp_get_num_procs();
+    for (int t = 1; ; t = t * 2 < procs ? t * 2 : procs) {
+        thread_counts.push_back(t);
+        if (t == procs) {
+            break;
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        bool ok;
+        if (strcmp(argv[i], "--pattern") == 0 && has_value) {
+            ok = parseSyntheticPattern(argv[++i], &pattern) == 0;
+        } else if (strcmp(argv[i], "--sizes") == 0 && has_value) {
+            ok = parseIntegerList(argv[++i], &sizes) == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && has_value) {
+            ok = parseIntegerList(argv[++i], &thread_counts) == 0;
+        } else if (strcmp(argv[i], "--weak-size") == 0 && has_value) {
+            weak_size = atoi(argv[++i]);
+            ok = weak_size >= 3;
+        } else if (strcmp(argv[i], "--repeats") == 0 && has_value) {
+            repeats = atoi(argv[++i]);
+            ok = repeats >= 1;
+        } else if (strcmp(argv[i], "--engine") == 0 && has_value) {
+            int engine = findEngine(argv[++i]);
+            ok = engine >= 0;
+            selected.push_back(engine);
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [--pattern <gradient|checkerboard|noise|natural>] [--sizes n,n,...] "
+                    "[--threads n,n,...] [--weak-size n] [--repeats n] [--engine name]...\n", argv[0]);
+            fprintf(stderr, "Engines:");
+            for (int e = 0; e < engine_count; e++) {
+                fprintf(stderr, " %s", engines[e].name);
+            }
+            fprintf(stderr, "\n");
+            return EXIT_FAILURE;
+        }
+    }
+    if (selected.empty()) {
+        for (int e = 0; e < engine_count; e++) {
+            selected.push_back(e);
+        }
+    }
+
+    ImageBuffer image;
+    initImageBuffer(&image);
+    ScalingOutputs out;
+
+    printf("Strong scaling: %s pattern, best of %d run(s), %d core(s)\n", syntheticPatternName(pattern),
+           repeats, procs);
+    printf("%-10s %-11s %7s %10s %9s %8s %10s\n", "engine", "size", "threads", "ms", "MP/s", "speedup",
+           "efficiency");
+    for (size_t s = 0; s < sizes.size(); s++) {
+        if (generateSyntheticImage(pattern, sizes[s], sizes[s], 1, &image) != 0) {
+            freeImageBuffer(&image);
+            return EXIT_FAILURE;
+        }
+        prepareOutputs(&out, sizes[s], sizes[s]);
+        double megapixels = (double)sizes[s] * sizes[s] / 1e6;
+        for (size_t e = 0; e < selected.size(); e++) {
+            double base = 0.0;
+            for (size_t t = 0; t < thread_counts.size(); t++) {
+                double time = timeEngine(selected[e], thread_counts[t], image, out, repeats);
+                if (time < 0.0) {
+                    fprintf(stderr, "Error: %s failed at %dx%d.\n", engines[selected[e]].name, sizes[s], sizes[s]);
+                    continue;
+                }
+                base = t == 0 ? time * thread_counts[t] : base;
+                char size_text[32];
+                snprintf(size_text, sizeof(size_text), "%dx%d", sizes[s], sizes[s]);
+                printf("%-10s %-11s %7d %10.3f %9.1f %8.2f %9.1f%%\n", engines[selected[e]].name, size_text,
+                       thread_counts[t], time * 1e3, megapixels / time, base / time,
+                       100.0 * base / (time * thread_counts[t]));
+            }
+        }
+    }
+
+    printf("\nWeak scaling: %s pattern, %dx%d pixels per thread, best of %d run(s)\n",
+           syntheticPatternName(pattern), weak_size, weak_size, repeats);
+    printf("%-10s %-11s %7s %10s %9s %10s\n", "engine", "size", "threads", "ms", "MP/s", "efficiency");
+    for (size_t e = 0; e < selected.size(); e++) {
+        double base = 0.0;
+        for (size_t t = 0; t < thread_counts.size(); t++) {
+            int height = weak_size * thread_counts[t];
+            if (generateSyntheticImage(pattern, weak_size, height, 1, &image) != 0) {
+                freeImageBuffer(&image);
+                return EXIT_FAILURE;
+            }
+            prepareOutputs(&out, weak_size, height);
+            double time = timeEngine(selected[e], thread_counts[t], image, out, repeats);
+            if (time < 0.0) {
+                fprintf(stderr, "Error: %s failed at %dx%d.\n", engines[selected[e]].name, weak_size, height);
+                continue;
+            }
+            // Per-thread work is constant, so the one-thread time is the ideal.
+            base = t == 0 ? time : base;
+            char size_text[32];
+            snprintf(size_text, sizeof(size_text), "%dx%d", weak_size, height);
+            printf("%-10s %-11s %7d %10.3f %9.1f %9.1f%%\n", engines[selected[e]].name, size_text,
+                   thread_counts[t], time * 1e3, (double)weak_size * height / 1e6 / time, 100.0 * base / time);
+        }
+    }
+
+    freeImageBuffer(&image);
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "sobel_sequence.h"
+#include "sobel_kernels.h"
+#include "sobel_hash.h"
+
+#include <string.h>
+#include <omp.h>
+
+#include <algorithm>
+
+#define MIN_TILE_SIZE 8
+
+// Hash of one RGB tile (sobel_hash.h). Only used to detect change between
+// consecutive frames.
+static uint64_t hashTile(const uint8_t* rgb, size_t stride, int x0, int y0, int x1, int y1) {
+    size_t bytes = (size_t)(x1 - x0) * 3;
+    uint64_t hash = HASH_PRIME2 ^ bytes;
+    for (int y = y0; y < y1; y++) {
+        hash = hashUpdate(hash, rgb + (size_t)y * stride + (size_t)x0 * 3, bytes);
+    }
+    return hashFinal(hash);
+}
+
+// Sobel over [x0, x1) x [y0, y1), clipped to the image interior.
+static void sobelRect(const uint8_t* gray, uint8_t* edges, int width, int height,
+                      int x0, int y0, int x1, int y1) {
+    x0 = std::max(x0, 1);
+    y0 = std::max(y0, 1);
+    x1 = std::min(x1, width - 1);
+    y1 = std::min(y1, height - 1);
+    for (int y = y0; y < y1; y++) {
+        sobelSpan(gray + (size_t)(y - 1) * width,
+                  gray + (size_t)y * width,
+                  gray + (size_t)(y + 1) * width,
+                  edges + (size_t)y * width, x0, x1);
+    }
+}
+
+SequenceEdgeDetector::SequenceEdgeDetector(int tile_size, int num_threads)
+    : tile_size_(std::max(tile_size, MIN_TILE_SIZE)),
+      num_threads_(num_threads > 0 ? num_threads : omp_get_max_threads()),
+      width_(0),
+      height_(0),
+      tiles_x_(0),
+      tiles_y_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void SequenceEdgeDetector::reset() {
+    width_ = 0;
+    height_ = 0;
+}
+
+const uint8_t* SequenceEdgeDetector::processFrame(const uint8_t* rgb, size_t stride, int width, int height) {
+    if (!rgb || width <= 0 || height <= 0 || stride < (size_t)width * 3) {
+        return NULL;
+    }
+
+    bool full = width != width_ || height != height_;
+    if (full) {
+        width_ = width;
+        height_ = height;
+        tiles_x_ = (width + tile_size_ - 1) / tile_size_;
+        tiles_y_ = (height + tile_size_ - 1) / tile_size_;
+        hashes_.assign((size_t)tiles_x_ * tiles_y_, 0);
+        dirty_.assign((size_t)tiles_x_ * tiles_y_, 1);
+        gray_.resize((size_t)width * height);
+        // Border pixels are never written by the stencil, so clear them once.
+        edges_.assign((size_t)width * height, 0);
+    }
+
+    const int tiles = tiles_x_ * tiles_y_;
+    const int tile = tile_size_;
+    uint8_t* gray = gray_.data();
+    uint8_t* edges = edges_.data();
+    uint64_t* hashes = hashes_.data();
+    uint8_t* dirty = dirty_.data();
+    int dirty_tiles = 0;
+
+    #pragma omp parallel num_threads(num_threads_)
+    {
+        // Pass 1: find changed tiles and refresh their grayscale.
+        #pragma omp for schedule(dynamic, 4) reduction(+:dirty_tiles)
+        for (int t = 0; t < tiles; t++) {
+            int x0 = (t % tiles_x_) * tile;
+            int y0 = (t / tiles_x_) * tile;
+            int x1 = std::min(x0 + tile, width);
+            int y1 = std::min(y0 + tile, height);
+            uint64_t hash = hashTile(rgb, stride, x0, y0, x1, y1);
+            dirty[t] = full || hash != hashes[t];
+            hashes[t] = hash;
+            if (dirty[t]) {
+                dirty_tiles++;
+                for (int y = y0; y < y1; y++) {
+                    grayscaleRow(rgb + (size_t)y * stride + (size_t)x0 * 3,
+                                 gray + (size_t)y * width + x0, x1 - x0);
+                }
+            }
+        }
+
+        // Pass 2: each thread owns whole output tiles, so no pixel is written
+        // twice. A clean tile only redoes the edge pixels whose 3x3 stencil
+        // reaches into a dirty neighbour.
+        #pragma omp for schedule(dynamic, 4)
+        for (int t = 0; t < tiles; t++) {
+            int tx = t % tiles_x_;
+            int ty = t / tiles_x_;
+            int x0 = tx * tile;
+            int y0 = ty * tile;
+            int x1 = std::min(x0 + tile, width);
+            int y1 = std::min(y0 + tile, height);
+
+            if (dirty[t]) {
+                sobelRect(gray, edges, width, height, x0, y0, x1, y1);
+                continue;
+            }
+
+            bool west = tx > 0, east = tx + 1 < tiles_x_;
+            bool north = ty > 0, south = ty + 1 < tiles_y_;
+            if (north && dirty[t - tiles_x_]) sobelRect(gray, edges, width, height, x0, y0, x1, y0 + 1);
+            if (south && dirty[t + tiles_x_]) sobelRect(gray, edges, width, height, x0, y1 - 1, x1, y1);
+            if (west && dirty[t - 1]) sobelRect(gray, edges, width, height, x0, y0, x0 + 1, y1);
+            if (east && dirty[t + 1]) sobelRect(gray, edges, width, height, x1 - 1, y0, x1, y1);
+            if (north && west && dirty[t - tiles_x_ - 1]) sobelRect(gray, edges, width, height, x0, y0, x0 + 1, y0 + 1);
+            if (north && east && dirty[t - tiles_x_ + 1]) sobelRect(gray, edges, width, height, x1 - 1, y0, x1, y0 + 1);
+            if (south && west && dirty[t + tiles_x_ - 1]) sobelRect(gray, edges, width, height, x0, y1 - 1, x0 + 1, y1);
+            if (south && east && dirty[t + tiles_x_ + 1]) sobelRect(gray, edges, width, height, x1 - 1, y1 - 1, x1, y1);
+        }
+    }
+
+    stats_.tiles = tiles;
+    stats_.dirty_tiles = dirty_tiles;
+    stats_.skipped_fraction = tiles ? (double)(tiles - dirty_tiles) / tiles : 0.0;
+    return edges;
+}
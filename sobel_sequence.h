@@ -0,0 +1,48 @@
+#ifndef SOBEL_SEQUENCE_H
+#define SOBEL_SEQUENCE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+typedef struct {
+    int tiles;
+    int dirty_tiles;
+    double skipped_fraction;  // tiles whose grayscale and Sobel were reused
+} SequenceStats;
+
+// Edge detection for frame sequences from a fixed camera. Each input tile is
+// hashed and compared with the previous frame; only changed tiles have their
+// grayscale recomputed, and Sobel is rerun only over changed tiles plus the
+// 1-pixel ring around them whose stencil reaches into a changed tile.
+// Everything else is reused from the previous frame.
+class SequenceEdgeDetector {
+public:
+    explicit SequenceEdgeDetector(int tile_size = 64, int num_threads = 0);
+
+    // Returns the edge map (width * height, packed), owned by the detector
+    // and valid until the next call, or NULL on bad arguments. A change of
+    // frame size starts a new sequence.
+    const uint8_t* processFrame(const uint8_t* rgb, size_t stride, int width, int height);
+
+    // Forget the previous frame so the next one is processed in full.
+    void reset();
+
+    const SequenceStats& lastStats() const { return stats_; }
+
+private:
+    int tile_size_;
+    int num_threads_;
+    int width_;
+    int height_;
+    int tiles_x_;
+    int tiles_y_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint8_t> dirty_;
+    std::vector<uint8_t> gray_;
+    std::vector<uint8_t> edges_;
+    SequenceStats stats_;
+};
+
+#endif // SOBEL_SEQUENCE_H
@@ -0,0 +1,195 @@
+#include "sobel_synthetic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#define RGB_CHANNELS 3
+#define SYNTHETIC_PREFIX "synthetic:"
+// Octaves of texture in the natural pattern: cells of 64, 32, 16, 8 and 4.
+#define NATURAL_OCTAVES 5
+// Per-pixel sensor grain, +-NATURAL_GRAIN levels; it sets how many weak
+// edges the flat regions produce.
+#define NATURAL_GRAIN 10
+#define NATURAL_REGIONS 6
+
+static const char* const pattern_names[SYNTHETIC_PATTERN_COUNT] = {
+    "gradient", "checkerboard", "noise", "natural"
+};
+
+// Region colours of the natural pattern: sky, foliage, earth, stone,
+// shadow, highlight.
+static const uint8_t natural_palette[NATURAL_REGIONS][RGB_CHANNELS] = {
+    {150, 180, 215}, {60, 110, 50}, {130, 95, 60}, {120, 120, 115}, {35, 35, 45}, {225, 215, 190}
+};
+
+const char* syntheticPatternName(SyntheticPattern pattern) {
+    return pattern >= 0 && pattern < SYNTHETIC_PATTERN_COUNT ? pattern_names[pattern] : "?";
+}
+
+int parseSyntheticPattern(const char* name, SyntheticPattern* pattern) {
+    for (int i = 0; i < SYNTHETIC_PATTERN_COUNT; i++) {
+        if (strcmp(name, pattern_names[i]) == 0) {
+            *pattern = (SyntheticPattern)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int parseIntegerList(const char* text, std::vector<int>* values) {
+    values->clear();
+    while (*text) {
+        char* end;
+        long value = strtol(text, &end, 10);
+        if (end == text || value <= 0 || (*end != ',' && *end != '\0')) {
+            return -1;
+        }
+        values->push_back((int)value);
+        text = *end ? end + 1 : end;
+    }
+    return values->empty() ? -1 : 0;
+}
+
+// Integer hash of a lattice point (lowbias32 finalizer over a combined key).
+static inline uint32_t hashPoint(uint32_t x, uint32_t y, uint32_t seed) {
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline float smoothStep(float t) {
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// Adds amplitude * (lattice noise - 0.5) to row y of out. The noise is
+// smoothly interpolated between hashed values on a grid of the given cell
+// size; the four corner hashes are computed once per cell, not per pixel.
+static void addNoiseRow(float* out, int y, int width, int cell, uint32_t seed, float amplitude) {
+    const float scale = amplitude / 4294967296.0f;
+    uint32_t cy = (uint32_t)(y / cell);
+    float fy = smoothStep((float)(y % cell) / cell);
+    for (int x0 = 0; x0 < width; x0 += cell) {
+        uint32_t cx = (uint32_t)(x0 / cell);
+        float top0 = hashPoint(cx, cy, seed) * scale, top1 = hashPoint(cx + 1, cy, seed) * scale;
+        float bottom0 = hashPoint(cx, cy + 1, seed) * scale, bottom1 = hashPoint(cx + 1, cy + 1, seed) * scale;
+        float left = top0 + (bottom0 - top0) * fy - 0.5f * amplitude;
+        float right = top1 + (bottom1 - top1) * fy - 0.5f * amplitude;
+        int x1 = x0 + cell < width ? x0 + cell : width;
+        for (int x = x0; x < x1; x++) {
+            out[x] += left + (right - left) * smoothStep((float)(x - x0) / cell);
+        }
+    }
+}
+
+static inline uint8_t clampByte(int value) {
+    return (uint8_t)(value < 0 ? 0 : value > 255 ? 255 : value);
+}
+
+// shape and texture are width-float scratch rows.
+static void naturalRow(uint8_t* row, int y, int width, uint32_t seed, float* shape, float* texture) {
+    // Two coarse octaves cut into regions with hard boundaries ...
+    memset(shape, 0, width * sizeof(float));
+    addNoiseRow(shape, y, width, SYNTHETIC_FEATURE_SIZE * 4, seed, 0.67f);
+    addNoiseRow(shape, y, width, SYNTHETIC_FEATURE_SIZE, seed + 1, 0.33f);
+    // ... textured by 1/f noise: each finer octave at half the amplitude.
+    memset(texture, 0, width * sizeof(float));
+    float amplitude = 0.5f;
+    for (int o = 0; o < NATURAL_OCTAVES; o++) {
+        addNoiseRow(texture, y, width, SYNTHETIC_FEATURE_SIZE >> o, seed + 2 + o, amplitude);
+        amplitude *= 0.5f;
+    }
+    for (int x = 0; x < width; x++) {
+        int region = (int)((shape[x] + 0.5f) * NATURAL_REGIONS);
+        region = region < 0 ? 0 : region < NATURAL_REGIONS ? region : NATURAL_REGIONS - 1;
+        int grain = (int)(hashPoint((uint32_t)x, (uint32_t)y, seed + 7) % (2 * NATURAL_GRAIN + 1)) - NATURAL_GRAIN;
+        int offset = (int)(texture[x] * 120.0f) + grain;
+        for (int c = 0; c < RGB_CHANNELS; c++) {
+            row[x * RGB_CHANNELS + c] = clampByte(natural_palette[region][c] + offset);
+        }
+    }
+}
+
+// scratch holds two width-float rows for the natural pattern.
+static void generateRow(SyntheticPattern pattern, uint8_t* row, int y, int width, int height,
+                        uint32_t seed, float* scratch) {
+    switch (pattern) {
+    case SYNTHETIC_GRADIENT: {
+        int green = (int)((int64_t)y * 255 / (height > 1 ? height - 1 : 1));
+        for (int x = 0; x < width; x++) {
+            row[x * 3] = (uint8_t)((int64_t)x * 255 / (width > 1 ? width - 1 : 1));
+            row[x * 3 + 1] = (uint8_t)green;
+            row[x * 3 + 2] = (uint8_t)((int64_t)(x + y) * 255 / (width + height > 2 ? width + height - 2 : 1));
+        }
+        break;
+    }
+    case SYNTHETIC_CHECKERBOARD:
+        for (int x = 0; x < width; x++) {
+            bool light = ((x / SYNTHETIC_FEATURE_SIZE) ^ (y / SYNTHETIC_FEATURE_SIZE)) & 1;
+            row[x * 3] = light ? 224 : 32;
+            row[x * 3 + 1] = light ? 208 : 48;
+            row[x * 3 + 2] = light ? 192 : 64;
+        }
+        break;
+    case SYNTHETIC_NOISE:
+        for (int x = 0; x < width; x++) {
+            uint32_t h = hashPoint((uint32_t)x, (uint32_t)y, seed);
+            row[x * 3] = (uint8_t)h;
+            row[x * 3 + 1] = (uint8_t)(h >> 8);
+            row[x * 3 + 2] = (uint8_t)(h >> 16);
+        }
+        break;
+    default:
+        naturalRow(row, y, width, seed, scratch, scratch + width);
+        break;
+    }
+}
+
+int generateSyntheticImage(SyntheticPattern pattern, int width, int height, uint32_t seed,
+                           ImageBuffer* image) {
+    if (width <= 0 || height <= 0 || pattern < 0 || pattern >= SYNTHETIC_PATTERN_COUNT) {
+        fprintf(stderr, "Error: Invalid synthetic image parameters.\n");
+        return -1;
+    }
+    const size_t stride = (size_t)width * RGB_CHANNELS;
+    if (reserveImageBuffer(image, stride * height) != 0) {
+        return -1;
+    }
+    image->width = width;
+    image->height = height;
+    image->channels = RGB_CHANNELS;
+    uint8_t* data = image->data;
+
+    #pragma omp parallel
+    {
+        std::vector<float> scratch(pattern == SYNTHETIC_NATURAL ? (size_t)width * 2 : 0);
+        #pragma omp for schedule(static)
+        for (int y = 0; y < height; y++) {
+            generateRow(pattern, data + (size_t)y * stride, y, width, height, seed, scratch.data());
+        }
+    }
+    return 0;
+}
+
+int loadImageOrSynthetic(const char* source, ImageBuffer* image) {
+    size_t prefix = strlen(SYNTHETIC_PREFIX);
+    if (strncmp(source, SYNTHETIC_PREFIX, prefix) != 0) {
+        return loadJPEGFile(source, image);
+    }
+    char name[32];
+    int width, height;
+    SyntheticPattern pattern;
+    if (sscanf(source + prefix, "%31[^:]:%dx%d", name, &width, &height) != 3 ||
+        parseSyntheticPattern(name, &pattern) != 0) {
+        fprintf(stderr, "Error: Expected %s<gradient|checkerboard|noise|natural>:<W>x<H>, got %s.\n",
+                SYNTHETIC_PREFIX, source);
+        return -1;
+    }
+    return generateSyntheticImage(pattern, width, height, 1, image);
+}
@@ -0,0 +1,47 @@
+#ifndef SOBEL_SYNTHETIC_H
+#define SOBEL_SYNTHETIC_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "sobel_jpeg_io.h"
+
+// Deterministic synthetic RGB test images, so benchmarks do not depend on a
+// local Large_image.jpg. Every pixel is a pure function of (x, y, seed):
+// the same call gives the same image at any thread count, and rows are
+// generated in parallel, which also first-touches them on the threads that
+// will process them.
+
+typedef enum {
+    SYNTHETIC_GRADIENT,     // smooth ramps; almost no edges
+    SYNTHETIC_CHECKERBOARD, // SYNTHETIC_FEATURE_SIZE squares; sparse, strong edges
+    SYNTHETIC_NOISE,        // independent uniform pixels; edges everywhere
+    SYNTHETIC_NATURAL,      // 1/f value noise with region boundaries, a photo-like
+                            // mix of flat areas, texture and a few strong edges
+    SYNTHETIC_PATTERN_COUNT
+} SyntheticPattern;
+
+// Cell size in pixels of the checkerboard and of the coarsest noise
+// octave. It does not scale with the image, so the edge density of a
+// pattern is the same at every size.
+#define SYNTHETIC_FEATURE_SIZE 64
+
+const char* syntheticPatternName(SyntheticPattern pattern);
+// Returns 0 and sets *pattern for "gradient", "checkerboard", "noise" or
+// "natural"; -1 otherwise.
+int parseSyntheticPattern(const char* name, SyntheticPattern* pattern);
+// Parses a comma-separated list of positive integers such as "64,256,1024"
+// for the benchmark options. Returns 0, or -1 if the list is empty or malformed.
+int parseIntegerList(const char* text, std::vector<int>* values);
+
+// Fills image with a width x height packed RGB image.
+// Returns 0 on success, -1 on failure (message on stderr).
+int generateSyntheticImage(SyntheticPattern pattern, int width, int height, uint32_t seed,
+                           ImageBuffer* image);
+
+// Benchmark input: "synthetic:<pattern>:<W>x<H>" generates an image (seed
+// 1), anything else is loaded as a JPEG file.
+int loadImageOrSynthetic(const char* source, ImageBuffer* image);
+
+#endif // SOBEL_SYNTHETIC_H
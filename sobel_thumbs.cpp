@@ -0,0 +1,104 @@
+// Small-image throughput: images per second for many thumbnails, one
+// process() call per image versus one processBatch() call for all of them.
+// The images are synthetic (a different seed each), so the run needs no
+// input files. Each size gets about the same total number of pixels, so
+// the columns compare per-image overhead rather than work.
+//
+//   g++ -O3 -march=native -fopenmp sobel_thumbs.cpp sobel_edge_detector.cpp sobel_synthetic.cpp sobel_jpeg_io.cpp -ljpeg -o sobel_thumbs
+//   ./sobel_thumbs [--sizes 64,256,1024] [--megapixels n] [--pattern name] [--repeats n]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_synthetic.h"
+
+int main(int argc, char** argv) {
+    std::vector<int> sizes = {64, 256, 1024};
+    double megapixels = 16.0;
+    SyntheticPattern pattern = SYNTHETIC_NATURAL;
+    int repeats = 5;
+
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        bool ok;
+        if (strcmp(argv[i], "--sizes") == 0 && has_value) {
+            ok = parseIntegerList(argv[++i], &sizes) == 0;
+        } else if (strcmp(argv[i], "--megapixels") == 0 && has_value) {
+            megapixels = atof(argv[++i]);
+            ok = megapixels > 0.0;
+        } else if (strcmp(argv[i], "--pattern") == 0 && has_value) {
+            ok = parseSyntheticPattern(argv[++i], &pattern) == 0;
+        } else if (strcmp(argv[i], "--repeats") == 0 && has_value) {
+            repeats = atoi(argv[++i]);
+            ok = repeats >= 1;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [--sizes n,n,...] [--megapixels n] "
+                    "[--pattern <gradient|checkerboard|noise|natural>] [--repeats n]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    EdgeDetector detector;
+    printf("%s pattern, about %.0f MP per size, best of %d run(s), %d thread(s)\n",
+           syntheticPatternName(pattern), megapixels, repeats, detector.numThreads());
+    printf("%-11s %7s %14s %14s %8s\n", "size", "images", "process() /s", "batch /s", "speedup");
+
+    for (size_t s = 0; s < sizes.size(); s++) {
+        const int size = sizes[s];
+        const size_t pixels = (size_t)size * size;
+        int count = (int)(megapixels * 1e6 / pixels);
+        count = count < 1 ? 1 : count;
+
+        std::vector<uint8_t> rgb(pixels * 3 * count);
+        std::vector<uint8_t> single(pixels * count), batched(pixels * count);
+        std::vector<SobelBatchItem> items(count);
+        ImageBuffer image;
+        initImageBuffer(&image);
+        for (int i = 0; i < count; i++) {
+            if (generateSyntheticImage(pattern, size, size, (uint32_t)i + 1, &image) != 0) {
+                freeImageBuffer(&image);
+                return EXIT_FAILURE;
+            }
+            memcpy(&rgb[pixels * 3 * i], image.data, pixels * 3);
+            items[i] = SobelBatchItem{&rgb[pixels * 3 * i], (size_t)size * 3, size, size, &batched[pixels * i]};
+        }
+        freeImageBuffer(&image);
+
+        // One warm-up each, so buffers are sized before timing.
+        double best_single = 0.0, best_batch = 0.0;
+        for (int r = 0; r <= repeats; r++) {
+            double start = omp_get_wtime();
+            for (int i = 0; i < count; i++) {
+                detector.process(items[i].rgb, items[i].stride, size, size, &single[pixels * i]);
+            }
+            double elapsed = omp_get_wtime() - start;
+            best_single = r == 1 || (r > 1 && elapsed < best_single) ? elapsed : best_single;
+
+            start = omp_get_wtime();
+            if (detector.processBatch(items.data(), count) != 0) {
+                fprintf(stderr, "Error: processBatch failed at %dx%d.\n", size, size);
+                return EXIT_FAILURE;
+            }
+            elapsed = omp_get_wtime() - start;
+            best_batch = r == 1 || (r > 1 && elapsed < best_batch) ? elapsed : best_batch;
+        }
+        if (single != batched) {
+            fprintf(stderr, "Error: processBatch output differs from process() at %dx%d.\n", size, size);
+            return EXIT_FAILURE;
+        }
+
+        char size_text[32];
+        snprintf(size_text, sizeof(size_text), "%dx%d", size, size);
+        printf("%-11s %7d %14.0f %14.0f %7.2fx\n", size_text, count, count / best_single, count / best_batch,
+               best_single / best_batch);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Edge detection with Deep Zoom (DZI) or XYZ tile pyramid output
+// (sobel_pyramid.h), for images too large to open as one JPEG. The edge
+// map is computed once; the full-resolution tiles are encoded straight
+// from it and the coarser levels are built by 2x2 downsampling, all in
+// parallel.
+//
+//   g++ -O3 -march=native -fopenmp sobel_tiles.cpp sobel_pyramid.cpp sobel_edge_detector.cpp sobel_jpeg_io.cpp sobel_synthetic.cpp -ljpeg -o sobel_tiles
+//   ./sobel_tiles [options] <input.jpg | synthetic:<pattern>:<W>x<H>> <output_base>
+//
+// Options:
+//   --xyz             <output_base>/<z>/<x>/<y>.jpg instead of
+//                     <output_base>.dzi and <output_base>_files/
+//   --tile-size <n>   tile size in pixels (254 for DZI, 256 for XYZ)
+//   --overlap <n>     DZI tile overlap in pixels (1)
+//   --quality <q>     JPEG quality of the tiles (95)
+//   --flat            also write <output_base>_flat.jpg and time it, for
+//                     comparison with the pyramid
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#include <string>
+#include <vector>
+
+#include "sobel_edge_detector.h"
+#include "sobel_jpeg_io.h"
+#include "sobel_pyramid.h"
+#include "sobel_synthetic.h"
+
+int main(int argc, char** argv) {
+    PyramidLayout layout = PYRAMID_DZI;
+    int tile_size = 0, overlap = -1, quality = 0;
+    bool flat = false;
+    int first_arg = 1;
+    bool ok = true;
+    while (ok && first_arg < argc && strncmp(argv[first_arg], "--", 2) == 0) {
+        const char* option = argv[first_arg];
+        bool has_value = first_arg + 1 < argc;
+        if (strcmp(option, "--xyz") == 0) {
+            layout = PYRAMID_XYZ;
+        } else if (strcmp(option, "--flat") == 0) {
+            flat = true;
+        } else if (strcmp(option, "--tile-size") == 0 && has_value) {
+            tile_size = atoi(argv[++first_arg]);
+            ok = tile_size > 0;
+        } else if (strcmp(option, "--overlap") == 0 && has_value) {
+            overlap = atoi(argv[++first_arg]);
+            ok = overlap >= 0;
+        } else if (strcmp(option, "--quality") == 0 && has_value) {
+            quality = atoi(argv[++first_arg]);
+            ok = quality >= 1 && quality <= 100;
+        } else {
+            ok = false;
+        }
+        first_arg++;
+    }
+    if (!ok || argc != first_arg + 2) {
+        fprintf(stderr, "Usage: %s [--xyz] [--tile-size n] [--overlap n] [--quality q] [--flat]\n"
+                        "           <input.jpg | synthetic:<pattern>:<W>x<H>> <output_base>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    PyramidOptions options = defaultPyramidOptions(layout);
+    options.tile_size = tile_size > 0 ? tile_size : options.tile_size;
+    options.overlap = overlap >= 0 ? overlap : options.overlap;
+    options.quality = quality > 0 ? quality : options.quality;
+    const char* base = argv[first_arg + 1];
+
+    double start = omp_get_wtime();
+    ImageBuffer rgb;
+    initImageBuffer(&rgb);
+    if (loadImageOrSynthetic(argv[first_arg], &rgb) != 0) {
+        return EXIT_FAILURE;
+    }
+    const int width = rgb.width;
+    const int height = rgb.height;
+    double decoded = omp_get_wtime();
+
+    EdgeDetector detector;
+    std::vector<uint8_t> edges((size_t)width * height);
+    if (detector.process(rgb.data, (size_t)width * 3, width, height, edges.data()) != 0) {
+        fprintf(stderr, "Error: Edge detection failed.\n");
+        freeImageBuffer(&rgb);
+        return EXIT_FAILURE;
+    }
+    freeImageBuffer(&rgb);
+    double detected = omp_get_wtime();
+
+    PyramidStats stats;
+    if (writeEdgePyramid(edges.data(), width, height, base, options, detector.numThreads(), &stats) != 0) {
+        return EXIT_FAILURE;
+    }
+    double written = omp_get_wtime();
+
+    printf("Image %dx%d: %d levels, %zu tiles of %d px (%s)\n", width, height, stats.levels, stats.tiles,
+           options.tile_size, layout == PYRAMID_DZI ? "DZI" : "XYZ");
+    printf("Time taken for decode: %f seconds\n", decoded - start);
+    printf("Time taken for edge detection: %f seconds\n", detected - decoded);
+    printf("Time taken for full-resolution tiles: %f seconds\n", stats.full_time);
+    printf("Time taken for coarser levels: %f seconds\n", stats.coarse_time);
+    printf("Total time: %f seconds\n", written - start);
+
+    if (flat) {
+        std::string path = std::string(base) + "_flat.jpg";
+        double flat_start = omp_get_wtime();
+        if (saveGrayJPEGFile(path.c_str(), edges.data(), width, height, options.quality) != 0) {
+            return EXIT_FAILURE;
+        }
+        printf("Time taken for flat JPEG (for comparison): %f seconds\n", omp_get_wtime() - flat_start);
+    }
+    return 0;
+}
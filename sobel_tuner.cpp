@@ -0,0 +1,259 @@
+#include "sobel_tuner.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <omp.h>
+
+#include <vector>
+
+#define PROBE_WIDTH 1536
+#define PROBE_HEIGHT 1024
+#define PROBE_REPEATS 5
+
+static const char* scheduleName(SobelSchedule schedule) {
+    return schedule == SOBEL_SCHEDULE_DYNAMIC ? "dynamic"
+         : schedule == SOBEL_SCHEDULE_GUIDED ? "guided" : "static";
+}
+
+int compiledSimdWidth() {
+#if defined(__AVX512F__)
+    return 64;
+#elif defined(__AVX2__) || defined(__AVX__)
+    return 32;
+#elif defined(__SSE2__) || defined(__ARM_NEON)
+    return 16;
+#else
+    return 0;
+#endif
+}
+
+static std::string hostName() {
+    char name[256];
+    if (gethostname(name, sizeof(name)) != 0) {
+        return "unknown";
+    }
+    name[sizeof(name) - 1] = '\0';
+    return name;
+}
+
+std::string defaultTuningProfilePath() {
+    const char* path = getenv("SOBEL_TUNE_PROFILE");
+    if (path && *path) {
+        return path;
+    }
+    const char* home = getenv("HOME");
+    return std::string(home ? home : ".") + "/.sobel_tune_" + hostName();
+}
+
+int loadTuningProfile(const char* path, EdgeTuning* tuning) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    char line[512];
+    char value[256];
+    std::string host;
+    int simd = -1;
+    int fields = 0;
+    EdgeTuning loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    while (fgets(line, sizeof(line), file)) {
+        int number;
+        if (sscanf(line, "host=%255s", value) == 1) {
+            host = value;
+        } else if (sscanf(line, "simd_bytes=%d", &number) == 1) {
+            simd = number;
+        } else if (sscanf(line, "threads=%d", &number) == 1) {
+            loaded.num_threads = number;
+            fields++;
+        } else if (sscanf(line, "schedule=%255s", value) == 1) {
+            loaded.schedule = strcmp(value, "dynamic") == 0 ? SOBEL_SCHEDULE_DYNAMIC
+                            : strcmp(value, "guided") == 0 ? SOBEL_SCHEDULE_GUIDED : SOBEL_SCHEDULE_STATIC;
+            fields++;
+        } else if (sscanf(line, "chunk=%d", &number) == 1) {
+            loaded.chunk = number;
+            fields++;
+        } else if (sscanf(line, "band_rows=%d", &number) == 1) {
+            loaded.band_rows = number;
+            fields++;
+        } else if (sscanf(line, "streaming_stores=%d", &number) == 1) {
+            loaded.streaming_stores = number;
+            fields++;
+        }
+    }
+    fclose(file);
+
+    // Profiles from before a field existed fail here and are re-tuned.
+    if (fields != 5 || host != hostName() || simd != compiledSimdWidth() ||
+        loaded.num_threads <= 0 || loaded.num_threads > omp_get_num_procs()) {
+        return -1;
+    }
+    *tuning = loaded;
+    return 0;
+}
+
+int saveTuningProfile(const char* path, const EdgeTuning& tuning, double ms_per_megapixel) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Error: Unable to open file %s for writing.\n", path);
+        return -1;
+    }
+    fprintf(file, "# EdgeDetector tuning profile, written by autoTune()\n");
+    fprintf(file, "host=%s\n", hostName().c_str());
+    fprintf(file, "simd_bytes=%d\n", compiledSimdWidth());
+    fprintf(file, "threads=%d\n", tuning.num_threads);
+    fprintf(file, "schedule=%s\n", scheduleName(tuning.schedule));
+    fprintf(file, "chunk=%d\n", tuning.chunk);
+    fprintf(file, "band_rows=%d\n", tuning.band_rows);
+    fprintf(file, "streaming_stores=%d\n", tuning.streaming_stores);
+    fprintf(file, "ms_per_megapixel=%.4f\n", ms_per_megapixel);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Unable to finish writing %s.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Rings over a gradient with pseudo-random noise: enough edges that the
+// Sobel pass does real work, deterministic so probes are comparable.
+static void fillProbeImage(std::vector<uint8_t>& rgb) {
+    uint32_t state = 12345;
+    for (int y = 0; y < PROBE_HEIGHT; y++) {
+        for (int x = 0; x < PROBE_WIDTH; x++) {
+            double dx = x - PROBE_WIDTH / 2, dy = y - PROBE_HEIGHT / 2;
+            int ring = ((int)sqrt(dx * dx + dy * dy) / 24) & 1 ? 180 : 40;
+            state = state * 1664525u + 1013904223u;
+            int noise = (int)(state >> 28) - 8;
+            uint8_t* pixel = &rgb[((size_t)y * PROBE_WIDTH + x) * 3];
+            pixel[0] = (uint8_t)(ring + noise);
+            pixel[1] = (uint8_t)((x * 255) / PROBE_WIDTH);
+            pixel[2] = (uint8_t)(ring / 2 + (y & 15));
+        }
+    }
+}
+
+// Best of PROBE_REPEATS timed calls after one warm-up, in ms per megapixel.
+static double probe(EdgeDetector& detector, const EdgeTuning& tuning,
+                    const std::vector<uint8_t>& rgb, std::vector<uint8_t>& out, bool verbose) {
+    if (detector.setTuning(tuning) != 0) {
+        return HUGE_VAL;
+    }
+    detector.process(rgb.data(), (size_t)PROBE_WIDTH * 3, PROBE_WIDTH, PROBE_HEIGHT, out.data());
+    double best = HUGE_VAL;
+    for (int i = 0; i < PROBE_REPEATS; i++) {
+        double start = omp_get_wtime();
+        detector.process(rgb.data(), (size_t)PROBE_WIDTH * 3, PROBE_WIDTH, PROBE_HEIGHT, out.data());
+        double elapsed = omp_get_wtime() - start;
+        best = elapsed < best ? elapsed : best;
+    }
+    double ms_per_megapixel = best * 1000.0 / (PROBE_WIDTH * (double)PROBE_HEIGHT / 1e6);
+    if (verbose) {
+        printf("  threads=%d schedule=%s chunk=%d band_rows=%d stream=%d: %.3f ms/MP\n",
+               tuning.num_threads, scheduleName(tuning.schedule), tuning.chunk, tuning.band_rows,
+               tuning.streaming_stores, ms_per_megapixel);
+    }
+    return ms_per_megapixel;
+}
+
+int autoTune(EdgeTuning* best, double* ms_per_megapixel, bool verbose) {
+    std::vector<uint8_t> rgb((size_t)PROBE_WIDTH * PROBE_HEIGHT * 3);
+    std::vector<uint8_t> out((size_t)PROBE_WIDTH * PROBE_HEIGHT);
+    fillProbeImage(rgb);
+
+    int max_threads = omp_get_num_procs();
+    EdgeDetector detector(max_threads);
+    EdgeTuning current = detector.tuning();
+    double current_time = HUGE_VAL;
+
+    // One parameter at a time, each stage starting from the best so far.
+    // Thread counts: powers of two up to the core count, plus the count.
+    for (int threads = 1; ; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        EdgeTuning candidate = current;
+        candidate.num_threads = threads;
+        double time = probe(detector, candidate, rgb, out, verbose);
+        if (time < current_time) {
+            current = candidate;
+            current_time = time;
+        }
+        if (threads == max_threads) {
+            break;
+        }
+    }
+
+    const struct { SobelSchedule schedule; int chunk; } schedules[] = {
+        {SOBEL_SCHEDULE_STATIC, 0}, {SOBEL_SCHEDULE_STATIC, 1}, {SOBEL_SCHEDULE_STATIC, 8},
+        {SOBEL_SCHEDULE_STATIC, 32}, {SOBEL_SCHEDULE_DYNAMIC, 1}, {SOBEL_SCHEDULE_DYNAMIC, 8},
+        {SOBEL_SCHEDULE_DYNAMIC, 32}, {SOBEL_SCHEDULE_GUIDED, 1}, {SOBEL_SCHEDULE_GUIDED, 8},
+    };
+    for (size_t i = 0; i < sizeof(schedules) / sizeof(schedules[0]); i++) {
+        if (schedules[i].schedule == current.schedule && schedules[i].chunk == current.chunk) {
+            continue;
+        }
+        EdgeTuning candidate = current;
+        candidate.schedule = schedules[i].schedule;
+        candidate.chunk = schedules[i].chunk;
+        double time = probe(detector, candidate, rgb, out, verbose);
+        if (time < current_time) {
+            current = candidate;
+            current_time = time;
+        }
+    }
+
+    // A band is already a large work item, so dynamic and guided schedules
+    // hand them out one at a time.
+    const int bands[] = {8, 16, 32, 64, 128};
+    for (size_t i = 0; i < sizeof(bands) / sizeof(bands[0]); i++) {
+        EdgeTuning candidate = current;
+        candidate.band_rows = bands[i];
+        candidate.chunk = candidate.schedule == SOBEL_SCHEDULE_STATIC ? 0 : 1;
+        double time = probe(detector, candidate, rgb, out, verbose);
+        if (time < current_time) {
+            current = candidate;
+            current_time = time;
+        }
+    }
+
+    // Streaming stores last: whether they win depends on how much of the
+    // working set the chosen decomposition keeps in cache.
+    EdgeTuning candidate = current;
+    candidate.streaming_stores = 1;
+    double time = probe(detector, candidate, rgb, out, verbose);
+    if (time < current_time) {
+        current = candidate;
+        current_time = time;
+    }
+
+    *best = current;
+    if (ms_per_megapixel) {
+        *ms_per_megapixel = current_time;
+    }
+    return 0;
+}
+
+int loadOrAutoTune(EdgeTuning* tuning, bool retune, bool verbose) {
+    std::string path = defaultTuningProfilePath();
+    if (!retune && loadTuningProfile(path.c_str(), tuning) == 0) {
+        if (verbose) {
+            printf("Tuning profile: %s\n", path.c_str());
+        }
+        return 0;
+    }
+    double ms_per_megapixel = 0.0;
+    if (verbose) {
+        printf("Auto-tuning (%dx%d probe image):\n", PROBE_WIDTH, PROBE_HEIGHT);
+    }
+    if (autoTune(tuning, &ms_per_megapixel, verbose) != 0) {
+        return -1;
+    }
+    if (verbose) {
+        printf("Best: threads=%d schedule=%s chunk=%d band_rows=%d stream=%d (%.3f ms/MP), saved to %s\n",
+               tuning->num_threads, scheduleName(tuning->schedule), tuning->chunk, tuning->band_rows,
+               tuning->streaming_stores, ms_per_megapixel, path.c_str());
+    }
+    // A profile that cannot be written only costs a re-tune next time.
+    saveTuningProfile(path.c_str(), *tuning, ms_per_megapixel);
+    return 0;
+}
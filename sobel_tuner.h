@@ -0,0 +1,37 @@
+#ifndef SOBEL_TUNER_H
+#define SOBEL_TUNER_H
+
+#include <string>
+
+#include "sobel_edge_detector.h"
+
+// Start-up auto-tuning for EdgeDetector::process(). Short probes on a
+// synthetic image try thread counts, OpenMP schedule kinds and chunk sizes,
+// band heights, and streaming stores. The winner goes to a per-host profile file that later
+// runs load instead of tuning again.
+//
+// The SIMD width is fixed when the kernels are compiled (-march). It is
+// recorded in the profile, and a profile measured with a different width
+// is ignored, so a binary built for another target tunes again.
+
+// Vector register width the kernels were compiled for, in bytes (64, 32,
+// 16) or 0 for scalar code.
+int compiledSimdWidth();
+
+// $SOBEL_TUNE_PROFILE if set, otherwise $HOME/.sobel_tune_<hostname>.
+std::string defaultTuningProfilePath();
+
+// Returns 0 and fills tuning if the profile exists and was written by this
+// host with the same SIMD width; -1 otherwise.
+int loadTuningProfile(const char* path, EdgeTuning* tuning);
+int saveTuningProfile(const char* path, const EdgeTuning& tuning, double ms_per_megapixel);
+
+// Runs the probes and returns the fastest configuration found. With
+// verbose set, every probe is printed.
+int autoTune(EdgeTuning* best, double* ms_per_megapixel, bool verbose);
+
+// Profile if there is a usable one (and retune is false), otherwise tune
+// and save a new profile.
+int loadOrAutoTune(EdgeTuning* tuning, bool retune, bool verbose);
+
+#endif // SOBEL_TUNER_H